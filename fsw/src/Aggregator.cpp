@@ -0,0 +1,146 @@
+/*
+    This file is part of SX128x Linux driver.
+    Copyright (C) 2020 ReimuNotMoe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Aggregator.hpp"
+
+Aggregator::Aggregator(SX128x& radio, uint8_t maxFrameSize, uint32_t maxDelayMs) : Radio(radio) {
+	if (maxFrameSize < HEADER_SIZE + 2) {
+		throw std::invalid_argument("Aggregator frame size must be at least " + std::to_string(HEADER_SIZE + 2));
+	}
+
+	MaxFrameSize = maxFrameSize;
+	MaxDelayNs = (uint64_t)maxDelayMs * 1000000;
+}
+
+bool Aggregator::Send(const uint8_t *message, uint8_t size) {
+	// FEC parity bytes take room from the frame
+	int frameSize = std::min<int>(MaxFrameSize, SX128x::TX_PACKET_MAX_SIZE - Radio.GetFecParity());
+
+	if (size == 0 || size > frameSize - HEADER_SIZE - 1) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lg(Lock);
+
+	bool queued = true;
+	uint64_t now = SX128x::SteadyClockNs();
+
+	if (FrameSize + 1 + size > frameSize) {
+		SizeFlushes++;
+		queued = FlushFrame();
+	}
+
+	if (FrameSize == 0) {
+		Frame[0] = FRAME_TYPE_AGGREGATE;
+		FrameSize = HEADER_SIZE;
+		FrameStarted = now;
+	}
+
+	Frame[FrameSize] = size;
+	memcpy(Frame + FrameSize + 1, message, size);
+	FrameSize += 1 + size;
+	FrameMessages++;
+
+	// Nothing more fits, or the message may not wait
+	if (FrameSize + 2 > frameSize) {
+		SizeFlushes++;
+		queued = FlushFrame() && queued;
+	} else if (now - FrameStarted >= MaxDelayNs) {
+		AgeFlushes++;
+		queued = FlushFrame() && queued;
+	}
+
+	return queued;
+}
+
+bool Aggregator::Poll(void) {
+	std::lock_guard<std::mutex> lg(Lock);
+
+	if (FrameMessages == 0 || SX128x::SteadyClockNs() - FrameStarted < MaxDelayNs) {
+		return true;
+	}
+
+	AgeFlushes++;
+
+	return FlushFrame();
+}
+
+bool Aggregator::Flush(void) {
+	std::lock_guard<std::mutex> lg(Lock);
+
+	return FlushFrame();
+}
+
+bool Aggregator::FlushFrame(void) {
+	if (FrameMessages == 0) {
+		return true;
+	}
+
+	bool queued = Radio.QueuePacket(Frame, FrameSize);
+
+	if (queued) {
+		MessagesSent += FrameMessages;
+		FramesSent++;
+	} else {
+		Drops += FrameMessages;
+	}
+
+	FrameSize = 0;
+	FrameMessages = 0;
+
+	return queued;
+}
+
+bool Aggregator::Input(const uint8_t *frame, uint8_t size) {
+	if (size <= HEADER_SIZE || frame[0] != FRAME_TYPE_AGGREGATE) {
+		return false;
+	}
+
+	FramesReceived++;
+
+	return true;
+}
+
+bool Aggregator::Next(const uint8_t *frame, uint8_t size, uint8_t& offset, const uint8_t *&message, uint8_t& messageSize) {
+	if (offset < HEADER_SIZE) {
+		offset = HEADER_SIZE;
+	}
+
+	if (offset >= size) {
+		return false;
+	}
+
+	// The messages before a bad size were already delivered
+	if (frame[offset] == 0 || offset + 1 + frame[offset] > size) {
+		BadFrames++;
+		offset = size;
+		return false;
+	}
+
+	messageSize = frame[offset];
+	message = frame + offset + 1;
+	offset += 1 + messageSize;
+
+	MessagesReceived++;
+
+	return true;
+}
+
+Aggregator::Stats_t Aggregator::GetStats(void) {
+	return { MessagesSent, FramesSent, SizeFlushes, AgeFlushes, Drops, FramesReceived, MessagesReceived, BadFrames };
+}
@@ -0,0 +1,159 @@
+/*
+    This file is part of SX128x Linux driver.
+    Copyright (C) 2020 ReimuNotMoe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <mutex>
+#include <atomic>
+
+#include <cinttypes>
+
+#include "SX128x.hpp"
+
+/*!
+ * \brief Packs small messages into one packet, so they share the preamble
+ *        and header of a single transmission
+ *
+ * A container is the frame type followed by the messages, each prefixed
+ * with its size on one byte. Messages are held until the next one doesn't
+ * fit in the frame size, or the oldest one has waited the maximum delay,
+ * then the container goes to the TX queue.
+ */
+class Aggregator {
+public:
+	static constexpr uint8_t FRAME_TYPE_AGGREGATE = 0xA1;
+	static constexpr uint8_t HEADER_SIZE = 1;
+	static constexpr uint8_t MESSAGE_MAX_SIZE = SX128x::TX_PACKET_MAX_SIZE - HEADER_SIZE - 1;
+
+	/*!
+	 * \brief Aggregation counters
+	 */
+	typedef struct {
+		uint64_t MessagesSent;                  //!< Messages handed to the TX queue in a container
+		uint64_t FramesSent;
+		uint64_t SizeFlushes;                   //!< Containers sent because the next message didn't fit
+		uint64_t AgeFlushes;                    //!< Containers sent because the oldest message waited the maximum delay
+		uint64_t Drops;                         //!< Messages lost because the TX queue was full
+		uint64_t FramesReceived;
+		uint64_t MessagesReceived;
+		uint64_t BadFrames;                     //!< Containers with a size overrunning the frame
+	} Stats_t;
+
+private:
+	SX128x& Radio;
+
+	uint8_t MaxFrameSize;
+	uint64_t MaxDelayNs;
+
+	/*!
+	 * \brief Container being filled, protected by Lock
+	 */
+	std::mutex Lock;
+	uint8_t Frame[SX128x::TX_PACKET_MAX_SIZE];
+	uint8_t FrameSize = 0;
+	uint8_t FrameMessages = 0;
+	uint64_t FrameStarted = 0;
+
+	std::atomic<uint64_t> MessagesSent{0};
+	std::atomic<uint64_t> FramesSent{0};
+	std::atomic<uint64_t> SizeFlushes{0};
+	std::atomic<uint64_t> AgeFlushes{0};
+	std::atomic<uint64_t> Drops{0};
+	std::atomic<uint64_t> FramesReceived{0};
+	std::atomic<uint64_t> MessagesReceived{0};
+	std::atomic<uint64_t> BadFrames{0};
+
+	/*!
+	 * \brief Queues the container and starts a new one. Must be called with
+	 *        Lock held.
+	 *
+	 * \retval      queued        false if the TX queue refused it
+	 */
+	bool FlushFrame(void);
+
+public:
+	/*!
+	 * \param [in]  radio         Radio, with the TX queue enabled
+	 * \param [in]  maxFrameSize  Largest container, at most
+	 *                            TX_PACKET_MAX_SIZE
+	 * \param [in]  maxDelayMs    Time a message may wait for others, 0 sends
+	 *                            each message in its own container
+	 */
+	Aggregator(SX128x& radio, uint8_t maxFrameSize, uint32_t maxDelayMs);
+
+	/*!
+	 * \brief Adds a message to the container, sending the container first if
+	 *        the message doesn't fit
+	 *
+	 * The messages end up in the TX queue, so don't queue packets from
+	 * another thread meanwhile.
+	 *
+	 * \param [in]  message       Message to send
+	 * \param [in]  size          Message size, at most the frame size minus 2
+	 *
+	 * \retval      accepted      false if the message is too large or a
+	 *                            container was refused by the TX queue
+	 */
+	bool Send(const uint8_t *message, uint8_t size);
+
+	/*!
+	 * \brief Sends the container if its oldest message waited the maximum
+	 *        delay. Call it more often than that delay.
+	 *
+	 * \retval      queued        false if the TX queue refused the container
+	 */
+	bool Poll(void);
+
+	/*!
+	 * \brief Sends the container now, if it holds a message
+	 *
+	 * \retval      queued        false if the TX queue refused the container
+	 */
+	bool Flush(void);
+
+	/*!
+	 * \brief Tells whether a received packet is a container, whose messages
+	 *        are then read by Next
+	 *
+	 * \param [in]  frame         Received packet
+	 * \param [in]  size          Packet size
+	 *
+	 * \retval      container     false if the packet isn't a container
+	 */
+	bool Input(const uint8_t *frame, uint8_t size);
+
+	/*!
+	 * \brief Reads the message at offset of a container accepted by Input
+	 *
+	 * \param [in]  frame         Container
+	 * \param [in]  size          Container size
+	 * \param [in,out] offset     Start of the message, 0 for the first one,
+	 *                            moved to the next one
+	 * \param [out] message       Start of the message in frame
+	 * \param [out] messageSize   Message size
+	 *
+	 * \retval      read          false once every message is read, or at a
+	 *                            size overrunning the container
+	 */
+	bool Next(const uint8_t *frame, uint8_t size, uint8_t& offset, const uint8_t *&message, uint8_t& messageSize);
+
+	/*!
+	 * \brief Returns the aggregation counters
+	 */
+	Stats_t GetStats(void);
+};
@@ -0,0 +1,328 @@
+/*
+    This file is part of SX128x Linux driver.
+    Copyright (C) 2020 ReimuNotMoe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Arq.hpp"
+
+Arq::Arq(Output_t output, AirTime_t airTime, uint8_t window, uint32_t marginMs, uint8_t maxPayload) : Output(std::move(output)), AirTime(std::move(airTime)) {
+	if (window == 0 || window > WINDOW_MAX) {
+		throw std::invalid_argument("ARQ window must be between 1 and " + std::to_string(WINDOW_MAX));
+	}
+
+	if (maxPayload == 0 || maxPayload > PAYLOAD_MAX_SIZE) {
+		throw std::invalid_argument("ARQ payload size must be between 1 and " + std::to_string(PAYLOAD_MAX_SIZE));
+	}
+
+	// Sequence numbers wrap at 65536, the slot of each must stay the same
+	Window = 1;
+	while (Window < window) {
+		Window <<= 1;
+	}
+
+	MaxPayload = maxPayload;
+	MarginNs = (uint64_t)marginMs * 1000000;
+
+	TxSlots.resize(Window);
+	RxSlots.resize(Window);
+
+	for (auto &it : TxSlots) {
+		it.Used = false;
+	}
+
+	for (auto &it : RxSlots) {
+		it.Filled = false;
+	}
+}
+
+Arq::Arq(SX128x& radio, uint8_t window, uint32_t marginMs) :
+	Arq([&radio](const uint8_t *frame, uint8_t size) { return radio.QueuePacket(frame, size); },
+	    [&radio](uint8_t size) { return (uint32_t)radio.GetTimeOnAir(size + radio.GetFecParity()); },
+	    window, marginMs, PAYLOAD_MAX_SIZE - radio.GetFecParity()) {
+}
+
+bool Arq::Send(const uint8_t *payload, uint8_t size) {
+	if (size == 0 || size > MaxPayload) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lg(Lock);
+
+	if ((uint16_t)( TxNext - TxBase ) >= Window) {
+		return false;
+	}
+
+	TxSlot_t& slot = TxSlots[TxNext % Window];
+
+	slot.Frame[0] = FRAME_TYPE_DATA;
+	slot.Frame[1] = 0;
+	slot.Frame[2] = TxNext >> 8;
+	slot.Frame[3] = TxNext;
+	memcpy(slot.Frame + DATA_HEADER_SIZE, payload, size);
+	slot.Size = DATA_HEADER_SIZE + size;
+	slot.Used = true;
+	slot.Acked = false;
+	slot.Pending = true;
+
+	TxNext++;
+
+	return true;
+}
+
+void Arq::Transmit(uint64_t now) {
+	uint16_t last = TxBase;
+	bool pending = false;
+
+	for (uint16_t seq = TxBase; seq != TxNext; seq++) {
+		if (TxSlots[seq % Window].Pending) {
+			last = seq;
+			pending = true;
+		}
+	}
+
+	if (!pending) {
+		return;
+	}
+
+	uint64_t airTime = 0;
+
+	RetryTime = 0;
+
+	for (uint16_t seq = TxBase; seq != (uint16_t)( last + 1 ); seq++) {
+		TxSlot_t& slot = TxSlots[seq % Window];
+
+		if (!slot.Pending) {
+			continue;
+		}
+
+		// Only the end of the burst asks for an ack, the receiver answers
+		// once this side listens again
+		slot.Frame[1] = ( seq == last ) ? FLAG_POLL : 0;
+
+		// The TX queue is full, Poll sends the rest once a frame had the
+		// time to go out
+		if (!Output(slot.Frame, slot.Size)) {
+			RetryTime = now + std::max<uint64_t>(AirTime(slot.Size), 1) * 1000000;
+			break;
+		}
+
+		slot.Pending = false;
+		slot.Order = TxOrder++;
+		Stats.FramesSent++;
+		airTime += AirTime(slot.Size);
+
+		if (seq == last) {
+			PollOrder = slot.Order;
+			AckDeadline = now + ( airTime + AirTime(ACK_SIZE) ) * 1000000 + MarginNs;
+		}
+	}
+}
+
+bool Arq::Input(const uint8_t *frame, uint8_t size) {
+	if (size == 0 || ( frame[0] != FRAME_TYPE_DATA && frame[0] != FRAME_TYPE_ACK )) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lg(Lock);
+
+	if (frame[0] == FRAME_TYPE_DATA && size > DATA_HEADER_SIZE) {
+		HandleData(frame, size);
+	} else if (frame[0] == FRAME_TYPE_ACK && size == ACK_SIZE) {
+		HandleAck(frame);
+	}
+
+	return true;
+}
+
+void Arq::HandleData(const uint8_t *frame, uint8_t size) {
+	uint16_t seq = ( (uint16_t)frame[2] << 8 ) | frame[3];
+	uint16_t offset = seq - RxNext;
+
+	Stats.FramesReceived++;
+
+	if (offset < Window) {
+		RxSlot_t& slot = RxSlots[seq % Window];
+
+		if (slot.Filled) {
+			Stats.Duplicates++;
+		} else {
+			slot.Size = size - DATA_HEADER_SIZE;
+			memcpy(slot.Payload, frame + DATA_HEADER_SIZE, slot.Size);
+			slot.Filled = true;
+		}
+	} else if (offset >= 0x8000) {
+		// Already handed over, its ack was lost
+		Stats.Duplicates++;
+	} else {
+		Stats.OutOfWindow++;
+	}
+
+	if (frame[1] & FLAG_POLL) {
+		SendAck(seq);
+	}
+}
+
+void Arq::SendAck(uint16_t pollSequence) {
+	uint16_t cumulative = RxNext;
+
+	while ((uint16_t)( cumulative - RxNext ) < Window && RxSlots[cumulative % Window].Filled) {
+		cumulative++;
+	}
+
+	uint32_t bitmap = 0;
+
+	for (uint8_t i = 0; i < 32; i++) {
+		uint16_t seq = cumulative + 1 + i;
+
+		if ((uint16_t)( seq - RxNext ) < Window && RxSlots[seq % Window].Filled) {
+			bitmap |= 1UL << i;
+		}
+	}
+
+	uint8_t frame[ACK_SIZE] = {FRAME_TYPE_ACK, (uint8_t)( cumulative >> 8 ), (uint8_t)cumulative,
+				   (uint8_t)( bitmap >> 24 ), (uint8_t)( bitmap >> 16 ), (uint8_t)( bitmap >> 8 ), (uint8_t)bitmap,
+				   (uint8_t)( pollSequence >> 8 ), (uint8_t)pollSequence};
+
+	if (Output(frame, ACK_SIZE)) {
+		Stats.AcksSent++;
+	}
+}
+
+void Arq::HandleAck(const uint8_t *frame) {
+	uint16_t cumulative = ( (uint16_t)frame[1] << 8 ) | frame[2];
+	uint32_t bitmap = ( (uint32_t)frame[3] << 24 ) | ( (uint32_t)frame[4] << 16 ) | ( (uint32_t)frame[5] << 8 ) | frame[6];
+	uint16_t pollSequence = ( (uint16_t)frame[7] << 8 ) | frame[8];
+	uint16_t inFlight = TxNext - TxBase;
+
+	Stats.AcksReceived++;
+
+	// An ack from before the window moved
+	if ((uint16_t)( cumulative - TxBase ) > inFlight) {
+		return;
+	}
+
+	// Order of the copy of the poll the receiver saw
+	bool known = (uint16_t)( pollSequence - TxBase ) < inFlight;
+	uint64_t pollOrder = known ? TxSlots[pollSequence % Window].Order : 0;
+
+	for (; TxBase != cumulative; TxBase++) {
+		TxSlots[TxBase % Window].Used = false;
+	}
+
+	for (uint8_t i = 0; i < 32; i++) {
+		uint16_t seq = cumulative + 1 + i;
+
+		if (( bitmap & ( 1UL << i ) ) && (uint16_t)( seq - TxBase ) < (uint16_t)( TxNext - TxBase )) {
+			TxSlots[seq % Window].Acked = true;
+		}
+	}
+
+	// Sent before the poll and still missing, so lost
+	if (known) {
+		for (uint16_t seq = TxBase; seq != TxNext; seq++) {
+			TxSlot_t& slot = TxSlots[seq % Window];
+
+			if (!slot.Acked && !slot.Pending && slot.Order < pollOrder) {
+				slot.Pending = true;
+				Stats.Retransmissions++;
+			}
+		}
+	}
+
+	// The answer to the last poll, or nothing left to ack
+	if (( known && pollOrder == PollOrder ) || TxBase == TxNext) {
+		AckDeadline = 0;
+	}
+
+	Transmit(SX128x::SteadyClockNs());
+}
+
+void Arq::Poll(void) {
+	std::lock_guard<std::mutex> lg(Lock);
+
+	uint64_t now = SX128x::SteadyClockNs();
+
+	// The poll or its ack was lost, the oldest frame asks again
+	if (AckDeadline != 0 && now >= AckDeadline) {
+		AckDeadline = 0;
+		Stats.AckTimeouts++;
+
+		for (uint16_t seq = TxBase; seq != TxNext; seq++) {
+			TxSlot_t& slot = TxSlots[seq % Window];
+
+			if (!slot.Acked) {
+				if (!slot.Pending) {
+					slot.Pending = true;
+					Stats.Retransmissions++;
+				}
+				break;
+			}
+		}
+	}
+
+	Transmit(now);
+}
+
+uint32_t Arq::PollIntervalMs(void) {
+	std::lock_guard<std::mutex> lg(Lock);
+
+	uint64_t now = SX128x::SteadyClockNs();
+	uint64_t next = UINT64_MAX;
+
+	for (uint16_t seq = TxBase; seq != TxNext; seq++) {
+		if (TxSlots[seq % Window].Pending) {
+			next = std::max(RetryTime, now);
+			break;
+		}
+	}
+
+	if (AckDeadline != 0) {
+		next = std::min(next, std::max(AckDeadline, now));
+	}
+
+	if (next == UINT64_MAX) {
+		return UINT32_MAX;
+	}
+
+	return ( next - now + 999999 ) / 1000000;
+}
+
+bool Arq::Receive(uint8_t *payload, uint8_t& size) {
+	std::lock_guard<std::mutex> lg(Lock);
+
+	RxSlot_t& slot = RxSlots[RxNext % Window];
+
+	if (!slot.Filled) {
+		return false;
+	}
+
+	size = slot.Size;
+	memcpy(payload, slot.Payload, slot.Size);
+	slot.Filled = false;
+	RxNext++;
+	Stats.Delivered++;
+
+	return true;
+}
+
+Arq::Stats_t Arq::GetStats(void) {
+	std::lock_guard<std::mutex> lg(Lock);
+
+	Stats_t stats = Stats;
+	stats.Unacked = (uint16_t)( TxNext - TxBase );
+
+	return stats;
+}
@@ -0,0 +1,210 @@
+/*
+    This file is part of SX128x Linux driver.
+    Copyright (C) 2020 ReimuNotMoe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <functional>
+
+#include <cinttypes>
+
+#include "SX128x.hpp"
+
+/*!
+ * \brief Selective repeat ARQ, for reliable bulk transfers over a half
+ *        duplex link
+ *
+ * Data frames carry a 16 bit sequence number. The sender keeps up to window
+ * frames unacknowledged. Queued frames leave together on the next Poll, the
+ * last one of the burst with the poll flag, so the receiver only answers
+ * once the sender listens again. The receiver answers a poll with an ack:
+ * the next sequence number it expects, a bitmap of the 32 frames after it,
+ * and the sequence number of the poll. Frames sent before the poll and missing from the ack are lost,
+ * only those are sent again. If no ack comes in time, the oldest frame is
+ * sent again with the poll flag to ask for a new ack.
+ *
+ * The ack timeout is the time on air of the burst and of the ack, plus a
+ * margin covering the turnaround of the peer. Both ends need the same
+ * window size.
+ *
+ * The link is reached through an output function and an airtime function,
+ * the radio constructor binds them to the TX queue and GetTimeOnAir, a
+ * simulated link can provide its own.
+ */
+class Arq {
+public:
+	static constexpr uint8_t FRAME_TYPE_DATA = 0xD1;
+	static constexpr uint8_t FRAME_TYPE_ACK = 0xD2;
+	static constexpr uint8_t FLAG_POLL = 0x01;
+	static constexpr uint8_t DATA_HEADER_SIZE = 4;
+	static constexpr uint8_t ACK_SIZE = 9;
+	static constexpr uint8_t PAYLOAD_MAX_SIZE = SX128x::TX_PACKET_MAX_SIZE - DATA_HEADER_SIZE;
+	static constexpr uint8_t WINDOW_MAX = 32;
+
+	/*!
+	 * \brief Sends a frame, returns false if it couldn't be queued
+	 */
+	typedef std::function<bool(const uint8_t *frame, uint8_t size)> Output_t;
+
+	/*!
+	 * \brief Returns the time on air of a frame of size bytes, milliseconds
+	 */
+	typedef std::function<uint32_t(uint8_t size)> AirTime_t;
+
+	/*!
+	 * \brief ARQ counters
+	 */
+	typedef struct {
+		uint64_t FramesSent;                    //!< Data frames sent, retransmissions included
+		uint64_t Retransmissions;               //!< Data frames sent again
+		uint64_t AckTimeouts;                   //!< Polls left without an ack in time
+		uint64_t AcksSent;
+		uint64_t AcksReceived;
+		uint64_t FramesReceived;
+		uint64_t Duplicates;                    //!< Data frames received twice
+		uint64_t OutOfWindow;                   //!< Data frames beyond the receive window
+		uint64_t Delivered;                     //!< Payloads handed over in order by Receive
+		size_t Unacked;                         //!< Frames waiting for an ack
+	} Stats_t;
+
+private:
+	typedef struct {
+		bool Used;
+		bool Acked;                             //!< Acked by the bitmap, ahead of TxBase
+		bool Pending;                           //!< Waits to be sent, or sent again
+		uint8_t Size;
+		uint64_t Order;                         //!< Transmission order of the last copy sent
+		uint8_t Frame[SX128x::TX_PACKET_MAX_SIZE];
+	} TxSlot_t;
+
+	typedef struct {
+		bool Filled;
+		uint8_t Size;
+		uint8_t Payload[PAYLOAD_MAX_SIZE];
+	} RxSlot_t;
+
+	Output_t Output;
+	AirTime_t AirTime;
+	uint8_t Window;
+	uint8_t MaxPayload;
+	uint64_t MarginNs;
+
+	std::mutex Lock;
+
+	/*!
+	 * \brief Sender state, slot of a sequence number is seq % Window
+	 */
+	std::vector<TxSlot_t> TxSlots;
+	uint16_t TxBase = 0;                        //!< Oldest unacknowledged frame
+	uint16_t TxNext = 0;                        //!< Sequence number of the next new frame
+	uint64_t TxOrder = 0;
+	uint64_t PollOrder = 0;                     //!< Transmission order of the last poll
+	uint64_t AckDeadline = 0;                   //!< 0 while no poll waits for an ack
+	uint64_t RetryTime = 0;                     //!< Output refused a frame, the next try is not before
+
+	/*!
+	 * \brief Receiver state
+	 */
+	std::vector<RxSlot_t> RxSlots;
+	uint16_t RxNext = 0;                        //!< Next payload Receive hands over
+
+	Stats_t Stats = {};
+
+	/*!
+	 * \brief Sends the pending frames, the last one with the poll flag, and
+	 *        starts the ack timer. Must be called with Lock held.
+	 */
+	void Transmit(uint64_t now);
+
+	/*!
+	 * \brief Answers a poll. Must be called with Lock held.
+	 */
+	void SendAck(uint16_t pollSequence);
+
+	/*!
+	 * \brief Handles an ack. Must be called with Lock held.
+	 */
+	void HandleAck(const uint8_t *frame);
+
+	/*!
+	 * \brief Stores a data frame, acking it if polled. Must be called with
+	 *        Lock held.
+	 */
+	void HandleData(const uint8_t *frame, uint8_t size);
+
+public:
+	/*!
+	 * \param [in]  output        Sends a frame
+	 * \param [in]  airTime       Time on air of a frame
+	 * \param [in]  window        Frames sent ahead of the acks, at most
+	 *                            WINDOW_MAX, rounded up to a power of two
+	 * \param [in]  marginMs      Time added to the ack timeout for the peer
+	 *                            to answer
+	 * \param [in]  maxPayload    Largest payload, at most PAYLOAD_MAX_SIZE
+	 */
+	Arq(Output_t output, AirTime_t airTime, uint8_t window, uint32_t marginMs, uint8_t maxPayload = PAYLOAD_MAX_SIZE);
+
+	/*!
+	 * \brief Runs over the TX queue of the radio, the payloads leave room
+	 *        for the FEC parity set at this time
+	 */
+	Arq(SX128x& radio, uint8_t window, uint32_t marginMs);
+
+	/*!
+	 * \brief Queues a payload, sent by the next Poll
+	 *
+	 * \retval      accepted      false if the window is full or the payload
+	 *                            too large
+	 */
+	bool Send(const uint8_t *payload, uint8_t size);
+
+	/*!
+	 * \brief Feeds a received packet to the ARQ
+	 *
+	 * \retval      arq           false if the packet isn't an ARQ frame
+	 */
+	bool Input(const uint8_t *frame, uint8_t size);
+
+	/*!
+	 * \brief Sends the queued frames and the lost ones, or the oldest frame
+	 *        when an ack is overdue. Call it at least every PollIntervalMs.
+	 */
+	void Poll(void);
+
+	/*!
+	 * \brief Returns the time until Poll has something to do, milliseconds.
+	 *        Frames the output refused wait for one of them to go out.
+	 */
+	uint32_t PollIntervalMs(void);
+
+	/*!
+	 * \brief Takes the next received payload, in sequence order
+	 *
+	 * \param [out] payload       Payload, PAYLOAD_MAX_SIZE bytes
+	 * \param [out] size          Payload size
+	 *
+	 * \retval      received      false if the next payload isn't in yet
+	 */
+	bool Receive(uint8_t *payload, uint8_t& size);
+
+	/*!
+	 * \brief Returns the ARQ counters
+	 */
+	Stats_t GetStats(void);
+};
@@ -0,0 +1,296 @@
+/*
+    This file is part of SX128x Linux driver.
+    Copyright (C) 2020 ReimuNotMoe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Fragmenter.hpp"
+
+#include <chrono>
+
+Fragmenter::Fragmenter(SX128x& radio, size_t slots, uint16_t maxMessageSize, uint32_t timeoutMs) : Radio(radio) {
+	if (slots == 0) {
+		throw std::invalid_argument("Fragmenter needs at least one reassembly slot");
+	}
+
+	if (maxMessageSize == 0 || maxMessageSize > MESSAGE_MAX_SIZE) {
+		throw std::invalid_argument("Fragmenter message size must be between 1 and " + std::to_string(MESSAGE_MAX_SIZE));
+	}
+
+	MaxMessageSize = maxMessageSize;
+	TimeoutNs = (uint64_t)timeoutMs * 1000000;
+
+	Slots.resize(slots);
+	for (auto &it : Slots) {
+		it.Used = false;
+		it.Data.resize(maxMessageSize);
+	}
+
+	Radio.SetTxSource([this](uint8_t offset) { return WriteFragment(offset); });
+}
+
+Fragmenter::~Fragmenter() {
+	Radio.SetTxSource(nullptr);
+}
+
+bool Fragmenter::Send(uint8_t stream, const uint8_t *message, uint16_t size, uint32_t timeoutMs) {
+	if (size == 0 || size > MaxMessageSize) {
+		throw std::invalid_argument("Fragmenter message size must be between 1 and " + std::to_string(MaxMessageSize));
+	}
+
+	// FEC parity bytes take room from the fragment payload
+	uint8_t payload = FRAGMENT_MAX_PAYLOAD - Radio.GetFecParity();
+	uint16_t count = ( size + payload - 1 ) / payload;
+
+	if (count > 255) {
+		throw std::invalid_argument("Fragmenter message too large for the FEC parity");
+	}
+
+	std::lock_guard<std::mutex> slg(SendLock);
+
+	{
+		std::lock_guard<std::mutex> lg(TxLock);
+
+		TxCount = count;
+		TxChunk = ( size + TxCount - 1 ) / TxCount;
+		TxIndex = 0;
+		TxStream = stream;
+		TxSequence = TxSequences[stream]++;
+		TxSize = size;
+		TxMessage = message;
+	}
+
+	// Starts the first fragment if the radio is idle, the end of each
+	// fragment starts the next one
+	try {
+		Radio.ResumeTxQueue();
+	} catch (...) {
+		std::lock_guard<std::mutex> lg(TxLock);
+		TxMessage = nullptr;
+		throw;
+	}
+
+	std::unique_lock<std::mutex> lg(TxLock);
+
+	if (!TxCond.wait_for(lg, std::chrono::milliseconds(timeoutMs), [this] { return TxMessage == nullptr; })) {
+		// Detached under TxLock, so the TX source doesn't read the
+		// message once Send has returned
+		TxMessage = nullptr;
+		SendTimeouts++;
+		return false;
+	}
+
+	MessagesSent++;
+
+	return true;
+}
+
+uint8_t Fragmenter::WriteFragment(uint8_t offset) {
+	std::unique_lock<std::mutex> lg(TxLock);
+
+	if (TxMessage == nullptr) {
+		return 0;
+	}
+
+	// Called again once the last fragment is done
+	if (TxIndex == TxCount) {
+		TxMessage = nullptr;
+		lg.unlock();
+		TxCond.notify_one();
+		return 0;
+	}
+
+	uint16_t start = TxIndex * TxChunk;
+	uint8_t length = std::min<uint16_t>(TxChunk, TxSize - start);
+	uint8_t header[HEADER_SIZE] = {FRAME_TYPE_FRAGMENT, TxStream, TxSequence, TxIndex, TxCount, (uint8_t)( TxSize >> 8 ), (uint8_t)TxSize};
+
+	// The payload goes from the message to the radio, no staging copy
+	Radio.WriteBuffer(offset, header, HEADER_SIZE);
+	Radio.WriteBuffer(offset + HEADER_SIZE, TxMessage + start, length);
+
+	uint8_t size = HEADER_SIZE + length;
+	std::shared_ptr<const ReedSolomon> fec = Radio.GetFec();
+
+	if (fec != nullptr) {
+		uint8_t parity[SX128x::FEC_PARITY_MAX] = {};
+
+		fec->Encode(header, HEADER_SIZE, parity);
+		fec->Encode(TxMessage + start, length, parity);
+		Radio.WriteBuffer(offset + size, parity, fec->GetParity());
+		size += fec->GetParity();
+	}
+
+	TxIndex++;
+	FragmentsSent++;
+
+	return size;
+}
+
+bool Fragmenter::Input(const uint8_t *frame, uint8_t size) {
+	if (size < HEADER_SIZE || frame[0] != FRAME_TYPE_FRAGMENT) {
+		return false;
+	}
+
+	uint8_t stream = frame[1];
+	uint8_t sequence = frame[2];
+	uint8_t index = frame[3];
+	uint8_t count = frame[4];
+	uint16_t total = ( (uint16_t)frame[5] << 8 ) | frame[6];
+
+	if (count == 0 || index >= count || total == 0 || total > MaxMessageSize) {
+		BadFragments++;
+		return true;
+	}
+
+	uint16_t chunk = ( total + count - 1 ) / count;
+	uint16_t start = index * chunk;
+
+	if (chunk > FRAGMENT_MAX_PAYLOAD || start >= total || size - HEADER_SIZE != std::min<uint16_t>(chunk, total - start)) {
+		BadFragments++;
+		return true;
+	}
+
+	uint64_t now = SX128x::SteadyClockNs();
+
+	ExpireSlots(now);
+
+	Slot_t& slot = FindSlot(stream, sequence);
+
+	if (!slot.Used) {
+		// A late copy of a fragment of the last delivered message
+		if (RxStreamSeen[stream] && RxSequences[stream] == sequence) {
+			Duplicates++;
+			return true;
+		}
+
+		slot.Used = true;
+		slot.Complete = false;
+		slot.Stream = stream;
+		slot.Sequence = sequence;
+		slot.Count = count;
+		slot.Received = 0;
+		slot.Size = total;
+		slot.Started = now;
+		slot.Fragments.reset();
+	} else if (slot.Count != count || slot.Size != total) {
+		BadFragments++;
+		return true;
+	}
+
+	FragmentsReceived++;
+
+	if (slot.Fragments[index]) {
+		Duplicates++;
+		return true;
+	}
+
+	memcpy(slot.Data.data() + start, frame + HEADER_SIZE, size - HEADER_SIZE);
+	slot.Fragments[index] = true;
+	slot.Received++;
+
+	if (slot.Received == slot.Count) {
+		slot.Complete = true;
+		slot.Order = CompleteOrder++;
+
+		// Sequence numbers wrap, a jump backwards is a reordering
+		uint8_t skipped = sequence - RxSequences[stream] - 1;
+		if (RxStreamSeen[stream] && skipped < 128) {
+			SequenceGaps += skipped;
+		}
+
+		RxStreamSeen[stream] = true;
+		RxSequences[stream] = sequence;
+	}
+
+	return true;
+}
+
+bool Fragmenter::Receive(uint8_t& stream, uint8_t *message, uint16_t& size, uint16_t maxSize) {
+	ExpireSlots(SX128x::SteadyClockNs());
+
+	Slot_t *oldest = nullptr;
+
+	for (auto &it : Slots) {
+		if (it.Used && it.Complete && ( oldest == nullptr || it.Order < oldest->Order )) {
+			oldest = &it;
+		}
+	}
+
+	if (oldest == nullptr) {
+		return false;
+	}
+
+	oldest->Used = false;
+
+	stream = oldest->Stream;
+	size = oldest->Size;
+
+	if (oldest->Size > maxSize) {
+		return false;
+	}
+
+	memcpy(message, oldest->Data.data(), oldest->Size);
+	MessagesReceived++;
+
+	return true;
+}
+
+void Fragmenter::ExpireSlots(uint64_t now) {
+	for (auto &it : Slots) {
+		if (it.Used && !it.Complete && now - it.Started > TimeoutNs) {
+			it.Used = false;
+			Timeouts++;
+		}
+	}
+}
+
+Fragmenter::Slot_t& Fragmenter::FindSlot(uint8_t stream, uint8_t sequence) {
+	Slot_t *unused = nullptr, *oldest = nullptr;
+
+	for (auto &it : Slots) {
+		if (!it.Used) {
+			if (unused == nullptr) {
+				unused = &it;
+			}
+		} else if (it.Stream == stream && it.Sequence == sequence) {
+			return it;
+		} else if (!it.Complete && ( oldest == nullptr || it.Started < oldest->Started )) {
+			oldest = &it;
+		}
+	}
+
+	if (unused != nullptr) {
+		return *unused;
+	}
+
+	// Complete messages wait for Receive, only partial ones are evicted. If
+	// every slot is complete the oldest complete one goes.
+	if (oldest == nullptr) {
+		for (auto &it : Slots) {
+			if (oldest == nullptr || it.Order < oldest->Order) {
+				oldest = &it;
+			}
+		}
+	}
+
+	oldest->Used = false;
+	Evictions++;
+
+	return *oldest;
+}
+
+Fragmenter::Stats_t Fragmenter::GetStats(void) {
+	return { MessagesSent, MessagesReceived, FragmentsSent, FragmentsReceived, SendTimeouts, Timeouts, Evictions, Duplicates, BadFragments, SequenceGaps };
+}
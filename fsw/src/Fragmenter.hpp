@@ -0,0 +1,206 @@
+/*
+    This file is part of SX128x Linux driver.
+    Copyright (C) 2020 ReimuNotMoe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <bitset>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#include <cinttypes>
+
+#include "SX128x.hpp"
+
+/*!
+ * \brief Splits messages larger than a packet into fragments and puts them
+ *        back together on the receiving side
+ *
+ * Each fragment starts with a header: frame type, stream, sequence number of
+ * the message in its stream, fragment index, fragment count and message
+ * size. Every fragment but the last carries the same number of bytes, so the
+ * receiver places a fragment from its header alone, in any order.
+ *
+ * Fragments are sent through the TX source of the radio: each one is written
+ * straight from the message into the data buffer of the radio when the
+ * previous packet is done, without going through a TX queue slot. Received
+ * fragments go into a fixed pool of reassembly slots, allocated once by the
+ * constructor.
+ */
+class Fragmenter {
+public:
+	static constexpr uint8_t FRAME_TYPE_FRAGMENT = 0xF1;
+	static constexpr uint8_t HEADER_SIZE = 7;
+	static constexpr uint8_t FRAGMENT_MAX_PAYLOAD = SX128x::TX_PACKET_MAX_SIZE - HEADER_SIZE;
+	static constexpr uint16_t MESSAGE_MAX_SIZE = FRAGMENT_MAX_PAYLOAD * 255;
+
+	/*!
+	 * \brief Fragmentation and reassembly counters
+	 */
+	typedef struct {
+		uint64_t MessagesSent;
+		uint64_t MessagesReceived;
+		uint64_t FragmentsSent;
+		uint64_t FragmentsReceived;
+		uint64_t SendTimeouts;                  //!< Messages whose fragments weren't all sent in time
+		uint64_t Timeouts;                      //!< Partial messages dropped because fragments stopped coming
+		uint64_t Evictions;                     //!< Partial messages dropped to free a slot
+		uint64_t Duplicates;                    //!< Fragments received twice
+		uint64_t BadFragments;                  //!< Fragments with an inconsistent header
+		uint64_t SequenceGaps;                  //!< Messages skipped in the sequence of a stream
+	} Stats_t;
+
+private:
+	typedef struct {
+		bool Used;
+		bool Complete;
+		uint8_t Stream;
+		uint8_t Sequence;
+		uint8_t Count;
+		uint8_t Received;
+		uint16_t Size;
+		uint64_t Started;                       //!< Time of the first fragment, nanoseconds
+		uint64_t Order;                         //!< Completion order, oldest is delivered first
+		std::bitset<256> Fragments;
+		std::vector<uint8_t> Data;
+	} Slot_t;
+
+	SX128x& Radio;
+
+	/*!
+	 * \brief Message being sent, protected by TxLock. The TX source reads
+	 *        it, so Send doesn't return before it's detached.
+	 */
+	std::mutex SendLock;
+	std::mutex TxLock;
+	std::condition_variable TxCond;
+	const uint8_t *TxMessage = nullptr;
+	uint16_t TxSize = 0;
+	uint8_t TxStream = 0;
+	uint8_t TxSequence = 0;
+	uint8_t TxCount = 0;
+	uint8_t TxChunk = 0;
+	uint8_t TxIndex = 0;
+	uint8_t TxSequences[256] = {};
+
+	/*!
+	 * \brief Reassembly state, used by the receiving thread only
+	 */
+	std::vector<Slot_t> Slots;
+	uint16_t MaxMessageSize;
+	uint64_t TimeoutNs;
+	uint64_t CompleteOrder = 0;
+	std::bitset<256> RxStreamSeen;
+	uint8_t RxSequences[256] = {};
+
+	std::atomic<uint64_t> MessagesSent{0};
+	std::atomic<uint64_t> MessagesReceived{0};
+	std::atomic<uint64_t> FragmentsSent{0};
+	std::atomic<uint64_t> FragmentsReceived{0};
+	std::atomic<uint64_t> SendTimeouts{0};
+	std::atomic<uint64_t> Timeouts{0};
+	std::atomic<uint64_t> Evictions{0};
+	std::atomic<uint64_t> Duplicates{0};
+	std::atomic<uint64_t> BadFragments{0};
+	std::atomic<uint64_t> SequenceGaps{0};
+
+	/*!
+	 * \brief TX source of the radio, writes the next fragment at offset
+	 *
+	 * \retval      size          Fragment size, 0 once the message is sent
+	 */
+	uint8_t WriteFragment(uint8_t offset);
+
+	/*!
+	 * \brief Drops partial messages whose first fragment is older than the
+	 *        reassembly timeout
+	 */
+	void ExpireSlots(uint64_t now);
+
+	/*!
+	 * \brief Returns the slot of a message, or a free one, evicting the
+	 *        oldest message if the pool is full
+	 */
+	Slot_t& FindSlot(uint8_t stream, uint8_t sequence);
+
+public:
+	/*!
+	 * \brief Installs the fragmenter as the TX source of the radio
+	 *
+	 * \param [in]  radio           Radio, with the TX queue enabled
+	 * \param [in]  slots           Messages reassembled at the same time
+	 * \param [in]  maxMessageSize  Largest message, at most MESSAGE_MAX_SIZE
+	 * \param [in]  timeoutMs       Time a partial message waits for its
+	 *                              missing fragments
+	 */
+	Fragmenter(SX128x& radio, size_t slots, uint16_t maxMessageSize, uint32_t timeoutMs);
+
+	Fragmenter(const Fragmenter&) = delete;
+	Fragmenter& operator=(const Fragmenter&) = delete;
+
+	~Fragmenter();
+
+	/*!
+	 * \brief Sends a message, split in as many fragments as needed
+	 *
+	 * Blocks until the last fragment is sent. The message isn't copied, it
+	 * must stay untouched until Send returns. Concurrent calls are sent one
+	 * after the other.
+	 *
+	 * \param [in]  stream        Stream of the message, each has its own
+	 *                            sequence numbers
+	 * \param [in]  message       Message to send
+	 * \param [in]  size          Message size
+	 * \param [in]  timeoutMs     Time to wait for the fragments to be sent
+	 *
+	 * \retval      sent          false if the fragments weren't all sent in
+	 *                            time
+	 */
+	bool Send(uint8_t stream, const uint8_t *message, uint16_t size, uint32_t timeoutMs);
+
+	/*!
+	 * \brief Feeds a received packet to the reassembly
+	 *
+	 * Input and Receive must be called by the same thread.
+	 *
+	 * \param [in]  frame         Received packet
+	 * \param [in]  size          Packet size
+	 *
+	 * \retval      fragment      false if the packet isn't a fragment
+	 */
+	bool Input(const uint8_t *frame, uint8_t size);
+
+	/*!
+	 * \brief Takes the oldest reassembled message
+	 *
+	 * \param [out] stream        Stream of the message
+	 * \param [out] message       Message
+	 * \param [out] size          Message size
+	 * \param [in]  maxSize       Size of message, a larger message is dropped
+	 *
+	 * \retval      received      false if no message is complete, or it was
+	 *                            larger than maxSize
+	 */
+	bool Receive(uint8_t& stream, uint8_t *message, uint16_t& size, uint16_t maxSize);
+
+	/*!
+	 * \brief Returns the fragmentation and reassembly counters
+	 */
+	Stats_t GetStats(void);
+};
@@ -22,6 +22,94 @@
 
 using namespace YukiWorkshop;
 
+namespace {
+	uint64_t line_flags(GPIO::LineMode __mode, GPIO::EventMode __event_mode, GPIO::EventClock __clock) {
+		using GPIO::LineMode;
+
+		if (!((__mode & LineMode::PullUp) == LineMode::PullUp || (__mode & LineMode::PullDown) == LineMode::PullDown)) {
+			__mode |= LineMode::NoPull;
+		}
+
+		uint64_t flags = (uint32_t)__mode;
+
+		if (__event_mode != GPIO::EventMode::None)
+			flags |= (uint32_t)__event_mode | (uint32_t)__clock;
+
+		return flags;
+	}
+
+	// Lines whose flags differ from the first line get a flags attribute,
+	// lines with equal flags share it
+	void set_line_attr_flags(gpio_v2_line_config& __config, uint64_t __flags, size_t __index) {
+		uint32_t i;
+
+		for (i=0; i<__config.num_attrs; i++) {
+			if (__config.attrs[i].attr.id == GPIO_V2_LINE_ATTR_ID_FLAGS && __config.attrs[i].attr.flags == __flags)
+				break;
+		}
+
+		if (i == __config.num_attrs) {
+			if (i == GPIO_V2_LINE_NUM_ATTRS_MAX)
+				throw std::invalid_argument("too many different line configurations in one request");
+
+			__config.attrs[i].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+			__config.attrs[i].attr.flags = __flags;
+			__config.num_attrs++;
+		}
+
+		__config.attrs[i].mask |= 1ULL << __index;
+	}
+
+	int request_lines(int __chip_fd, const GPIO::LineConfig *__lines, size_t __count, const std::string& __label,
+			  uint32_t __event_buffer_size = 0, GPIO::EventClock __clock = GPIO::EventClock::Monotonic) {
+		if (__count == 0 || __count > GPIO_V2_LINES_MAX)
+			throw std::invalid_argument("bad number of lines in request");
+
+		gpio_v2_line_request req{};
+		uint64_t output_values = 0, output_mask = 0;
+
+		for (size_t i=0; i<__count; i++) {
+			uint64_t flags = line_flags(__lines[i].mode, __lines[i].event_mode, __clock);
+
+			req.offsets[i] = __lines[i].line_number;
+
+			if (i == 0)
+				req.config.flags = flags;
+			else if (flags != req.config.flags)
+				set_line_attr_flags(req.config, flags, i);
+
+			if (flags & GPIO_V2_LINE_FLAG_OUTPUT) {
+				output_mask |= 1ULL << i;
+				if (__lines[i].default_value)
+					output_values |= 1ULL << i;
+			}
+		}
+
+		if (output_mask) {
+			if (req.config.num_attrs == GPIO_V2_LINE_NUM_ATTRS_MAX)
+				throw std::invalid_argument("too many different line configurations in one request");
+
+			auto& attr = req.config.attrs[req.config.num_attrs++];
+			attr.attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+			attr.attr.values = output_values;
+			attr.mask = output_mask;
+		}
+
+		strncpy(req.consumer, __label.c_str(), GPIO_MAX_NAME_SIZE-1);
+		req.num_lines = __count;
+		req.event_buffer_size = __event_buffer_size;
+
+		if (ioctl(__chip_fd, GPIO_V2_GET_LINE_IOCTL, &req))
+			throw ExceptionWithErrno("failed to request lines");
+
+		return req.fd;
+	}
+
+	GPIO::LineEventData to_event_data(const gpio_v2_line_event& __event) {
+		return {(GPIO::EventType)__event.id, __event.offset, __event.timestamp_ns, __event.seqno, __event.line_seqno};
+	}
+}
+
 std::vector<GPIO::Device> GPIO::all_devices() {
 	std::vector<GPIO::Device> ret;
 
@@ -75,10 +163,10 @@ void GPIO::Device::get_device_info() {
 std::map<uint32_t, std::string> &GPIO::Device::lines_by_num() {
 	if (lines_by_num_.empty()) {
 		for (uint32_t i=0; i<num_lines_; i++) {
-			gpioline_info linfo{};
-			linfo.line_offset = i;
+			gpio_v2_line_info linfo{};
+			linfo.offset = i;
 
-			if (ioctl(fd, GPIO_GET_LINEINFO_IOCTL, &linfo))
+			if (ioctl(fd, GPIO_V2_GET_LINEINFO_IOCTL, &linfo))
 				throw ExceptionWithErrno("failed to get line info");
 
 			lines_by_num_.insert({i, linfo.name});
@@ -91,10 +179,10 @@ std::map<uint32_t, std::string> &GPIO::Device::lines_by_num() {
 std::map<std::string, uint32_t> &GPIO::Device::lines_by_name() {
 	if (lines_by_name_.empty()) {
 		for (uint32_t i=0; i<num_lines_; i++) {
-			gpioline_info linfo{};
-			linfo.line_offset = i;
+			gpio_v2_line_info linfo{};
+			linfo.offset = i;
 
-			if (ioctl(fd, GPIO_GET_LINEINFO_IOCTL, &linfo))
+			if (ioctl(fd, GPIO_V2_GET_LINEINFO_IOCTL, &linfo))
 				throw ExceptionWithErrno("failed to get line info");
 
 			lines_by_name_.insert({linfo.name, i});
@@ -111,6 +199,10 @@ void GPIO::Device::open(const std::string &__path) {
 	get_device_info();
 	path_ = __path;
 
+	// Wakes the event listener up when it's asked to stop
+	if (wakefd < 0 && (wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+		throw ExceptionWithErrno("failed to create wakeup eventfd");
+
 	if (debug)
 		std::cerr << "GPIO++: " << "Device " << __path << " opened";
 }
@@ -121,59 +213,35 @@ void GPIO::Device::open(uint32_t __id) {
 
 GPIO::LineSingle
 GPIO::Device::line(uint32_t __line_number, GPIO::LineMode __mode, uint8_t __default_value, const std::string &__label) {
-	gpiohandle_request req{};
-
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,4,0)
-	if (!((__mode & LineMode::PullUp) == LineMode::PullUp || (__mode & LineMode::PullDown) == LineMode::PullDown)) {
-		__mode |= LineMode::NoPull;
-	}
-#endif
+	LineConfig lc{__line_number, __mode, EventMode::None, __default_value};
+	int req_fd = request_lines(fd, &lc, 1, __label);
 
-	req.lineoffsets[0] = __line_number;
-	req.default_values[0] = __default_value;
-	req.flags = (uint32_t)__mode;
-	strncpy(req.consumer_label, __label.c_str(), 31);
-	req.lines = 1;
+	gpio_v2_line_info linfo{};
+	linfo.offset = __line_number;
 
-	if (ioctl(fd, GPIO_GET_LINEHANDLE_IOCTL, &req))
-		throw ExceptionWithErrno("failed to get line handle");
-
-	gpioline_info linfo{};
-	linfo.line_offset = __line_number;
-
-	if (ioctl(fd, GPIO_GET_LINEINFO_IOCTL, &linfo))
+	if (ioctl(fd, GPIO_V2_GET_LINEINFO_IOCTL, &linfo)) {
+		close(req_fd);
 		throw ExceptionWithErrno("failed to get line info");
+	}
 
 	if (debug)
 		std::cerr << "GPIO++: " << "Line " << __line_number << " opened, mode="
 			  << (uint)__mode << ", default_value=" << __default_value << ", label=" << __label << "\n";
 
-	return LineSingle(req.fd, fd, 1, linfo);
+	return LineSingle(req_fd, fd, 1, linfo);
 }
 
 GPIO::LineMultiple
 GPIO::Device::line(const std::initializer_list<LineSpec> &__lss, GPIO::LineMode __mode, const std::string &__label) {
-	gpiohandle_request req{};
+	LineConfig lcs[GPIO_V2_LINES_MAX];
 
-	uint8_t usable_size = __lss.size() > 64 ? 64 : __lss.size();
+	uint8_t usable_size = __lss.size() > GPIO_V2_LINES_MAX ? GPIO_V2_LINES_MAX : __lss.size();
 
 	for (uint8_t i=0; i<usable_size; i++) {
-		req.lineoffsets[i] = (__lss.begin()+i)->line_number;
-		req.default_values[i] = (__lss.begin()+i)->default_value;
-	}
-
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,4,0)
-	if (!((__mode & LineMode::PullUp) == LineMode::PullUp || (__mode & LineMode::PullDown) == LineMode::PullDown)) {
-		__mode |= LineMode::NoPull;
+		lcs[i] = {(__lss.begin()+i)->line_number, __mode, EventMode::None, (__lss.begin()+i)->default_value};
 	}
-#endif
 
-	strncpy(req.consumer_label, __label.c_str(), 31);
-	req.flags = (uint32_t)__mode;
-	req.lines = usable_size;
-
-	if (ioctl(fd, GPIO_GET_LINEHANDLE_IOCTL, &req))
-		throw ExceptionWithErrno("failed to get line handle");
+	int req_fd = request_lines(fd, lcs, usable_size, __label);
 
 	if (debug)
 		for (uint8_t i=0; i<usable_size; i++) {
@@ -182,34 +250,64 @@ GPIO::Device::line(const std::initializer_list<LineSpec> &__lss, GPIO::LineMode
 		}
 
 
-	return LineMultiple(req.fd, usable_size);
+	return LineMultiple(req_fd, usable_size);
+}
+
+GPIO::LineEvent GPIO::Device::event_line(uint32_t __line_number, GPIO::LineMode __line_mode, GPIO::EventMode __event_mode,
+					 const std::string &__label, uint32_t __event_buffer_size, GPIO::EventClock __clock) {
+	LineConfig lc{__line_number, __line_mode, __event_mode};
+	int req_fd = request_lines(fd, &lc, 1, __label, __event_buffer_size, __clock);
+
+	// Non blocking reads let drain() empty the event queue
+	if (fcntl(req_fd, F_SETFL, fcntl(req_fd, F_GETFL) | O_NONBLOCK)) {
+		close(req_fd);
+		throw ExceptionWithErrno("failed to set event line non blocking");
+	}
+
+	if (debug)
+		std::cerr << "GPIO++: " << "Event line " << __line_number << " opened, eventflags="
+			  << (uint)__event_mode << ", label=" << __label << "\n";
+
+	return LineEvent(req_fd, __line_number, __label);
 }
 
 int GPIO::Device::add_event(uint32_t __line_number, GPIO::LineMode __line_mode, GPIO::EventMode __event_mode,
 			    const std::function<void(EventType, uint64_t)>& __handler, const std::string &__label) {
+	return add_event({{__line_number, __line_mode, __event_mode}},
+			 [__handler](const LineEventData& e) {
+				 __handler(e.type, e.timestamp);
+			 }, __label);
+}
+
+int GPIO::Device::add_event(const std::vector<LineConfig> &__lines, const std::function<void(const LineEventData&)> &__handler,
+			    const std::string &__label, uint32_t __event_buffer_size, GPIO::EventClock __clock) {
 	std::unique_lock<std::shared_mutex> lk(event_lock);
 
-	gpioevent_request req{};
-	req.lineoffset = __line_number;
-	req.handleflags = (uint32_t)__line_mode;
-	req.eventflags = (uint32_t)__event_mode;
-	strncpy(req.consumer_label, __label.c_str(), 31);
+	int req_fd = request_lines(fd, __lines.data(), __lines.size(), __label, __event_buffer_size, __clock);
 
-	if (ioctl(fd, GPIO_GET_LINEEVENT_IOCTL, &req)) {
-		throw ExceptionWithErrno("failed to setup events");
+	// Non blocking reads let process_event() drain the queue
+	if (fcntl(req_fd, F_SETFL, fcntl(req_fd, F_GETFL) | O_NONBLOCK)) {
+		close(req_fd);
+		throw ExceptionWithErrno("failed to set event line non blocking");
 	}
 
-	events_map.insert({req.fd, __handler});
+	event_slots.push_back({req_fd, 0, __handler, {}});
 
 	if (epfd > 0) {
 		epoll_event ev;
 		ev.events = EPOLLIN;
-		ev.data.fd = req.fd;
+		ev.data.fd = req_fd;
 
-		epoll_ctl(epfd, EPOLL_CTL_ADD, req.fd, &ev);
+		epoll_ctl(epfd, EPOLL_CTL_ADD, req_fd, &ev);
 	}
 
-	return req.fd;
+	if (debug)
+		for (auto &it : __lines) {
+			std::cerr << "GPIO++: " << "Event line " << it.line_number << " opened, eventflags="
+				  << (uint)it.event_mode << ", label=" << __label << "\n";
+		}
+
+	return req_fd;
 }
 
 void GPIO::Device::remove_event(int __event_handle) {
@@ -218,27 +316,93 @@ void GPIO::Device::remove_event(int __event_handle) {
 	if (epfd > 0)
 		epoll_ctl(epfd, EPOLL_CTL_DEL, __event_handle, nullptr);
 
-	events_map.erase(__event_handle);
+	for (auto it = event_slots.begin(); it != event_slots.end(); it++) {
+		if (it->fd == __event_handle) {
+			event_slots.erase(it);
+			break;
+		}
+	}
+}
+
+GPIO::Device::EventSlot *GPIO::Device::find_event_slot(int __fd) {
+	for (auto &it : event_slots) {
+		if (it.fd == __fd)
+			return &it;
+	}
+
+	return nullptr;
 }
 
 void GPIO::Device::process_event(int __event_handle) {
 	std::shared_lock<std::shared_mutex> lk(event_lock);
 
-	gpioevent_data event;
-	auto it = events_map.find(__event_handle);
-	if (it != events_map.end() &&
-	    read(__event_handle, &event, sizeof(gpioevent_data)) == sizeof(gpioevent_data))
-		events_map[__event_handle]((EventType)event.id, event.timestamp);
-	else
+	EventSlot *slot = find_event_slot(__event_handle);
+	if (!slot)
 		throw std::logic_error("event handle not found, check your code!");
+
+	gpio_v2_line_event events[EVENT_BATCH_SIZE];
+	size_t total = 0;
+	ssize_t rc;
+
+	// The kernel hands out as many whole events as fit, a full batch means
+	// more may be waiting
+	while ((rc = read(__event_handle, events, sizeof(events))) > 0) {
+		size_t count = rc / sizeof(gpio_v2_line_event);
+
+		for (size_t i=0; i<count; i++) {
+			// The kernel drops the oldest event on overflow, which leaves a gap
+			// in the sequence numbers
+			if (slot->last_seqno && events[i].seqno > slot->last_seqno + 1)
+				slot->stats.overruns += events[i].seqno - slot->last_seqno - 1;
+			slot->last_seqno = events[i].seqno;
+
+			slot->handler(to_event_data(events[i]));
+		}
+
+		total += count;
+
+		if (count < EVENT_BATCH_SIZE)
+			break;
+	}
+
+	if (total) {
+		slot->stats.events += total;
+		slot->stats.wakeups++;
+		slot->stats.coalesced += total - 1;
+	}
+}
+
+GPIO::EventStats GPIO::Device::event_stats(int __event_handle) {
+	// The listener updates the counters under the shared lock
+	std::unique_lock<std::shared_mutex> lk(event_lock);
+
+	EventSlot *slot = find_event_slot(__event_handle);
+	if (!slot)
+		throw std::logic_error("event handle not found, check your code!");
+
+	return slot->stats;
+}
+
+uint64_t GPIO::Device::event_values(int __event_handle) {
+	std::shared_lock<std::shared_mutex> lk(event_lock);
+
+	if (!find_event_slot(__event_handle))
+		throw std::logic_error("event handle not found, check your code!");
+
+	gpio_v2_line_values data{0, ~0ULL};
+
+	if (ioctl(__event_handle, GPIO_V2_LINE_GET_VALUES_IOCTL, &data))
+		throw ExceptionWithErrno("failed to read values from event lines");
+
+	return data.bits;
 }
 
 std::vector<int> GPIO::Device::event_fds() {
 	std::shared_lock<std::shared_mutex> lk(event_lock);
 
 	std::vector<int> ret;
-	for (auto &it : events_map) {
-		ret.emplace_back(it.first);
+	for (auto &it : event_slots) {
+		ret.emplace_back(it.fd);
 	}
 	return ret;
 }
@@ -246,76 +410,162 @@ std::vector<int> GPIO::Device::event_fds() {
 bool GPIO::Device::is_event_fd(int __fd) {
 	std::shared_lock<std::shared_mutex> lk(event_lock);
 
-	return events_map.find(__fd) != events_map.end();
+	return find_event_slot(__fd) != nullptr;
 }
 
 void GPIO::Device::run_eventlistener() {
 	eventlistener_run = true;
 
-	epfd = epoll_create(42);
+	std::unique_lock<std::shared_mutex> lk(event_lock);
 
-	std::shared_lock<std::shared_mutex> lk(event_lock);
-	for (auto &it : events_map) {
-		epoll_event ev;
+	if ((epfd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+		eventlistener_run = false;
+		throw ExceptionWithErrno("failed to create epoll instance");
+	}
+
+	epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = wakefd;
+
+	epoll_ctl(epfd, EPOLL_CTL_ADD, wakefd, &ev);
+
+	for (auto &it : event_slots) {
 		ev.events = EPOLLIN;
-		ev.data.fd = it.first;
+		ev.data.fd = it.fd;
 
-		epoll_ctl(epfd, EPOLL_CTL_ADD, it.first, &ev);
+		epoll_ctl(epfd, EPOLL_CTL_ADD, it.fd, &ev);
 	}
 	lk.unlock();
 
 	int ep_rc;
 	epoll_event evs[16];
+	bool stop = false;
+
+	// No timeout, stop_eventlistener() wakes the loop through wakefd
+	while (!stop) {
+		ep_rc = epoll_wait(epfd, evs, 16, -1);
+
+		if (ep_rc == -1) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
 
-	while ((ep_rc = epoll_wait(epfd, evs, 16, 1000)) != -1) {
-		if (ep_rc > 0) {
          //cfs error: comparison of integer expressions of different signedness: ‘uint’ {aka ‘unsigned int’} and ‘int’
 			//cfs for (uint i=0; i<ep_rc; i++)
-         for (int i=0; i<ep_rc; i++) //cfs
+         for (int i=0; i<ep_rc; i++) { //cfs
+			if (evs[i].data.fd == wakefd) {
+				uint64_t count;
+				if (read(wakefd, &count, sizeof(count)) == sizeof(count))
+					stop = true;
+			} else {
 				process_event(evs[i].data.fd);
-		}
-
-		if (!eventlistener_run) {
-			close(epfd);
-			epfd = -1;
-			break;
+			}
 		}
 	}
 
+	lk.lock();
+	close(epfd);
+	epfd = -1;
+	lk.unlock();
+
+	eventlistener_run = false;
 }
 
 void GPIO::Device::stop_eventlistener() {
-	eventlistener_run = false;
+	uint64_t one = 1;
+
+	if (write(wakefd, &one, sizeof(one)) != sizeof(one))
+		throw ExceptionWithErrno("failed to wake up event listener");
 }
 
 uint8_t GPIO::LineSingle::read() {
-	gpiohandle_data data{};
+	gpio_v2_line_values data{0, 1};
 
-	if (ioctl(fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data))
+	if (ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &data))
 		throw ExceptionWithErrno("failed to read value from line");
 
+	uint8_t value = data.bits & 1;
+
 	if (debug)
-		std::cerr << "GPIO++: " << "Line " << number() << " '" << label() << "': value read: " << +data.values[0] << "\n";
+		std::cerr << "GPIO++: " << "Line " << number() << " '" << label() << "': value read: " << +value << "\n";
 
-	return data.values[0];
+	return value;
 }
 
 void GPIO::LineSingle::write(uint8_t __value) {
-	gpiohandle_data data{};
-	data.values[0] = __value;
+	gpio_v2_line_values data{__value ? 1ULL : 0ULL, 1};
 
-	if (ioctl(fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data))
+	if (ioctl(fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &data))
 		throw ExceptionWithErrno("failed to write value to line");
 
 	if (debug)
-		std::cerr << "GPIO++: " << "Line " << number() << " '" << label() << "': value write: " << +data.values[0] << "\n";
+		std::cerr << "GPIO++: " << "Line " << number() << " '" << label() << "': value write: " << +__value << "\n";
+}
+
+uint8_t GPIO::LineEvent::read() {
+	gpio_v2_line_values data{0, 1};
+
+	if (ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &data))
+		throw ExceptionWithErrno("failed to read value from event line");
+
+	return data.bits & 1;
+}
+
+void GPIO::LineEvent::drain() {
+	gpio_v2_line_event events[16];
+
+	while (::read(fd, events, sizeof(events)) == sizeof(events));
+}
+
+bool GPIO::LineEvent::wait(std::chrono::nanoseconds __timeout, GPIO::EventType *__type, uint64_t *__timestamp) {
+	LineEventData event;
+
+	if (!wait(__timeout, event))
+		return false;
+
+	if (__type)
+		*__type = event.type;
+
+	if (__timestamp)
+		*__timestamp = event.timestamp;
+
+	return true;
+}
+
+bool GPIO::LineEvent::wait(std::chrono::nanoseconds __timeout, GPIO::LineEventData &__event) {
+	pollfd pfd{fd, POLLIN, 0};
+
+	auto secs = std::chrono::duration_cast<std::chrono::seconds>(__timeout);
+	timespec ts{(time_t)secs.count(), (long)(__timeout - secs).count()};
+
+	int rc;
+
+	do {
+		rc = ppoll(&pfd, 1, &ts, nullptr);
+	} while (rc < 0 && errno == EINTR);
+
+	if (rc < 0)
+		throw ExceptionWithErrno("failed to wait for event");
+
+	if (rc == 0)
+		return false;
+
+	gpio_v2_line_event event;
+
+	if (::read(fd, &event, sizeof(gpio_v2_line_event)) != sizeof(gpio_v2_line_event))
+		return false;
+
+	__event = to_event_data(event);
+
+	return true;
 }
 
 GPIO::LineMode GPIO::LineSingle::mode() const {
-	gpioline_info linfo{};
-	linfo.line_offset = offset_;
+	gpio_v2_line_info linfo{};
+	linfo.offset = offset_;
 
-	if (ioctl(pfd, GPIO_GET_LINEINFO_IOCTL, &linfo))
+	if (ioctl(pfd, GPIO_V2_GET_LINEINFO_IOCTL, &linfo))
 		throw ExceptionWithErrno("failed to get line info");
 
 	return (LineMode)linfo.flags;
@@ -324,41 +574,37 @@ GPIO::LineMode GPIO::LineSingle::mode() const {
 void GPIO::LineSingle::set_mode(GPIO::LineMode __mode, uint8_t __default_value, const std::string &__label) {
 	close(fd);
 
-	gpiohandle_request req{};
-
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,4,0)
-	if (!((__mode & LineMode::PullUp) == LineMode::PullUp || (__mode & LineMode::PullDown) == LineMode::PullDown)) {
-		__mode |= LineMode::NoPull;
-	}
-#endif
-
-	req.lineoffsets[0] = offset_;
-	req.default_values[0] = __default_value;
-	req.flags = (uint32_t)__mode;
-	strncpy(req.consumer_label, __label.c_str(), 31);
-	req.lines = 1;
-
-	if (ioctl(pfd, GPIO_GET_LINEHANDLE_IOCTL, &req))
-		throw ExceptionWithErrno("failed to get line handle");
+	LineConfig lc{offset_, __mode, EventMode::None, __default_value};
+	fd = request_lines(pfd, &lc, 1, __label);
 
 	if (debug)
 		std::cerr << "GPIO++: " << "Line " << number() << ": mode changed, mode="
 			  << (uint)__mode << ", default_value=" << __default_value << ", label=" << __label << "\n";
-
-	fd = req.fd;
 }
 
 std::vector<uint8_t> GPIO::LineMultiple::read() {
-	std::vector<uint8_t> ret(sizeof(gpiohandle_data));
+	gpio_v2_line_values data{0, size < 64 ? (1ULL << size) - 1 : ~0ULL};
 
-	if (ioctl(fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, ret.data()))
+	if (ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &data))
 		throw ExceptionWithErrno("failed to read values from lines");
 
-	ret.resize(size);
+	std::vector<uint8_t> ret(size);
+
+	for (uint8_t i=0; i<size; i++)
+		ret[i] = (data.bits >> i) & 1;
+
 	return ret;
 }
 
 void GPIO::LineMultiple::write(const std::vector<uint8_t> &__values) {
-	if (ioctl(fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, __values.data()))
+	gpio_v2_line_values data{};
+
+	for (uint8_t i=0; i<size && i<__values.size(); i++) {
+		data.mask |= 1ULL << i;
+		if (__values[i])
+			data.bits |= 1ULL << i;
+	}
+
+	if (ioctl(fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &data))
 		throw ExceptionWithErrno("failed to write values to lines");
 }
@@ -22,10 +22,11 @@
 #include <string>
 #include <iostream>
 #include <initializer_list>
-#include <unordered_map>
 #include <map>
+#include <atomic>
 #include <functional>
 #include <shared_mutex>
+#include <chrono>
 #include <stdexcept>
 #include <system_error>
 
@@ -37,21 +38,16 @@
 #include <linux/gpio.h>
 #include <linux/types.h>
 #include <linux/version.h>
+#include <poll.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
 
 #include "Utils.hpp"
 
-#ifndef GPIOHANDLE_REQUEST_BIAS_DISABLE
-#define GPIOHANDLE_REQUEST_BIAS_DISABLE 0
-#endif
-
-#ifndef GPIOHANDLE_REQUEST_BIAS_PULL_UP
-#define GPIOHANDLE_REQUEST_BIAS_PULL_UP 0
-#endif
-
-#ifndef GPIOHANDLE_REQUEST_BIAS_PULL_DOWN
-#define GPIOHANDLE_REQUEST_BIAS_PULL_DOWN 0
+// Lines are requested through the v2 character device uAPI (gpio_v2_line_request)
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5,10,0)
+#error "GPIO++ needs the GPIO character device v2 uAPI (Linux 5.10 or newer headers)"
 #endif
 
 namespace YukiWorkshop::GPIO {
@@ -59,28 +55,41 @@ namespace YukiWorkshop::GPIO {
 	class Line;
 
 	enum class LineMode : int {
-		Input = GPIOHANDLE_REQUEST_INPUT,
-		Output = GPIOHANDLE_REQUEST_OUTPUT,
-		ActiveLow = GPIOHANDLE_REQUEST_ACTIVE_LOW,
-		OpenDrain = GPIOHANDLE_REQUEST_OPEN_DRAIN,
-		OpenSource = GPIOHANDLE_REQUEST_OPEN_SOURCE,
-		NoPull = GPIOHANDLE_REQUEST_BIAS_DISABLE,
-		PullUp = GPIOHANDLE_REQUEST_BIAS_PULL_UP,
-		PullDown = GPIOHANDLE_REQUEST_BIAS_PULL_DOWN,
+		Input = GPIO_V2_LINE_FLAG_INPUT,
+		Output = GPIO_V2_LINE_FLAG_OUTPUT,
+		ActiveLow = GPIO_V2_LINE_FLAG_ACTIVE_LOW,
+		OpenDrain = GPIO_V2_LINE_FLAG_OPEN_DRAIN,
+		OpenSource = GPIO_V2_LINE_FLAG_OPEN_SOURCE,
+		NoPull = GPIO_V2_LINE_FLAG_BIAS_DISABLED,
+		PullUp = GPIO_V2_LINE_FLAG_BIAS_PULL_UP,
+		PullDown = GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN,
 	};
 
 	enum class EventMode : int {
-		RisingEdge = GPIOEVENT_REQUEST_RISING_EDGE,
-		FallingEdge = GPIOEVENT_REQUEST_FALLING_EDGE,
+		None = 0,
+		RisingEdge = GPIO_V2_LINE_FLAG_EDGE_RISING,
+		FallingEdge = GPIO_V2_LINE_FLAG_EDGE_FALLING,
 		Both = RisingEdge | FallingEdge
 	};
 
 	enum class EventType : int {
-		RisingEdge = GPIOEVENT_EVENT_RISING_EDGE,
-		FallingEdge = GPIOEVENT_EVENT_FALLING_EDGE,
+		RisingEdge = GPIO_V2_LINE_EVENT_RISING_EDGE,
+		FallingEdge = GPIO_V2_LINE_EVENT_FALLING_EDGE,
 		Both = RisingEdge | FallingEdge
 	};
 
+	// Clock the kernel uses to timestamp edge events
+	enum class EventClock : int {
+		Monotonic = 0,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,11,0)
+		Realtime = GPIO_V2_LINE_FLAG_EVENT_CLOCK_REALTIME,
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,19,0)
+		// Hardware timestamp engine, needs a GPIO controller with HTE support
+		Hte = GPIO_V2_LINE_FLAG_EVENT_CLOCK_HTE,
+#endif
+	};
+
 	inline constexpr LineMode operator&(LineMode x, LineMode y) {
 		return static_cast<LineMode>(static_cast<int>(x) & static_cast<int>(y));
 	}
@@ -179,6 +188,23 @@ namespace YukiWorkshop::GPIO {
 		uint8_t default_value;
 	};
 
+	// Per line settings of a multi-line request, lines of one request may
+	// differ in mode and edge detection
+	struct LineConfig {
+		uint32_t line_number;
+		LineMode mode = LineMode::Input;
+		EventMode event_mode = EventMode::None;
+		uint8_t default_value = 0;
+	};
+
+	struct LineEventData {
+		EventType type;
+		uint32_t line_number;
+		uint64_t timestamp;	// ns, in the clock the request was made with
+		uint32_t seqno;		// sequence number within the request
+		uint32_t line_seqno;	// sequence number within the line
+	};
+
 	class Line {
 	protected:
 		int fd = -1;
@@ -201,9 +227,9 @@ namespace YukiWorkshop::GPIO {
 	public:
 		LineSingle() = default;
 
-		LineSingle(int __fd, int __pfd, size_t __size, const gpioline_info& __info) : Line(__fd, __size) {
+		LineSingle(int __fd, int __pfd, size_t __size, const gpio_v2_line_info& __info) : Line(__fd, __size) {
 			pfd = __pfd;
-			offset_ = __info.line_offset;
+			offset_ = __info.offset;
 			name_ = __info.name;
 			label_ = __info.consumer;
 		}
@@ -212,6 +238,7 @@ namespace YukiWorkshop::GPIO {
 			fd = dup(other.fd);
 			size = other.size;
 			pfd = other.pfd;
+			offset_ = other.offset_;
 			name_ = other.name_;
 			label_ = other.label_;
 		}
@@ -220,6 +247,7 @@ namespace YukiWorkshop::GPIO {
 			fd = dup(other.fd);
 			size = other.size;
 			pfd = other.pfd;
+			offset_ = other.offset_;
 			name_ = other.name_;
 			label_ = other.label_;
 
@@ -270,11 +298,76 @@ namespace YukiWorkshop::GPIO {
 		void write(const std::vector<uint8_t>& __values);
 	};
 
+	// A line requested for edge events that is waited on directly instead of
+	// through the Device event listener
+	class LineEvent : public Line {
+	private:
+		uint32_t offset_ = 0;
+		std::string label_;
+	public:
+		LineEvent() = default;
+
+		LineEvent(int __fd, uint32_t __offset, const std::string& __label) : Line(__fd, 1) {
+			offset_ = __offset;
+			label_ = __label;
+		}
+
+		LineEvent(const LineEvent& other) : Line(dup(other.fd), other.size) {
+			offset_ = other.offset_;
+			label_ = other.label_;
+		}
+
+		LineEvent& operator=(const LineEvent& other) {
+			fd = dup(other.fd);
+			size = other.size;
+			offset_ = other.offset_;
+			label_ = other.label_;
+
+			return *this;
+		}
+
+		const std::string& label() const noexcept {
+			return label_;
+		}
+
+		uint32_t number() const noexcept {
+			return offset_;
+		}
+
+		uint8_t read();
+
+		// Discards the events queued so far
+		void drain();
+
+		// Waits for the next event, returns false on timeout
+		bool wait(std::chrono::nanoseconds __timeout, EventType *__type = nullptr, uint64_t *__timestamp = nullptr);
+		bool wait(std::chrono::nanoseconds __timeout, LineEventData& __event);
+	};
+
+	// Counters of one event request, kept by the event listener
+	struct EventStats {
+		uint64_t events = 0;		// events dispatched to the handler
+		uint64_t wakeups = 0;		// listener wakeups that found events
+		uint64_t coalesced = 0;		// events drained in the same wakeup as an earlier one
+		uint64_t overruns = 0;		// events the kernel dropped because its buffer was full
+	};
+
 	class Device {
 	private:
+		// Number of events taken with one read() when draining a request
+		static constexpr size_t EVENT_BATCH_SIZE = 16;
+
+		struct EventSlot {
+			int fd;
+			uint32_t last_seqno;
+			std::function<void(const LineEventData&)> handler;
+			EventStats stats;
+		};
+
 		int fd = -1;
 		int epfd = -1;
-		bool eventlistener_run = false;
+		int wakefd = -1;
+		std::atomic<bool> eventlistener_run{false};
 
 		std::string path_;
 		std::string name_, label_;
@@ -284,7 +377,10 @@ namespace YukiWorkshop::GPIO {
 		std::map<uint32_t, std::string> lines_by_num_;
 		std::map<std::string, uint32_t> lines_by_name_;
 
-		std::unordered_map<int, std::function<void(EventType, uint64_t)>> events_map;
+		// Few requests per device, a linear search beats hashing here
+		std::vector<EventSlot> event_slots;
+
+		EventSlot *find_event_slot(int __fd);
 
 		void get_device_info();
 
@@ -306,6 +402,8 @@ namespace YukiWorkshop::GPIO {
 				close(fd);
 			if (epfd > 0)
 				close(epfd);
+			if (wakefd > 0)
+				close(wakefd);
 		}
 
 		Device& operator=(const Device& other) {
@@ -342,19 +440,41 @@ namespace YukiWorkshop::GPIO {
 		LineSingle line(uint32_t __line_number, LineMode __mode, uint8_t __default_value = 0, const std::string& __label = "");
 		LineMultiple line(const std::initializer_list<LineSpec>& __lss, LineMode __mode, const std::string& __label = "");
 
+		LineEvent event_line(uint32_t __line_number, LineMode __line_mode, EventMode __event_mode, const std::string& __label = "",
+				     uint32_t __event_buffer_size = 0, EventClock __clock = EventClock::Monotonic);
+
 		int add_event(uint32_t __line_number, LineMode __line_mode, EventMode __event_mode,
 			      const std::function<void(EventType, uint64_t)>& __handler, const std::string& __label = "");
 
+		// Requests all the lines with one file descriptor, the handler gets the
+		// events of every line that has edge detection enabled. An event buffer
+		// size of 0 lets the kernel pick 16 events per line.
+		int add_event(const std::vector<LineConfig>& __lines, const std::function<void(const LineEventData&)>& __handler,
+			      const std::string& __label = "", uint32_t __event_buffer_size = 0, EventClock __clock = EventClock::Monotonic);
+
 		void remove_event(int __event_handle);
 
+		// Drains all the queued events of the handle and dispatches them
 		void process_event(int __event_handle);
 
+		EventStats event_stats(int __event_handle);
+
+		// Levels of the lines of an event request, bit i is the i-th line
+		// of the request
+		uint64_t event_values(int __event_handle);
+
 		std::vector<int> event_fds();
 
 		bool is_event_fd(int __fd);
 
+		// Blocks until stop_eventlistener() is called, a stop requested before
+		// the listener runs makes it return right away
 		void run_eventlistener();
 		void stop_eventlistener();
+
+		bool eventlistener_running() const noexcept {
+			return eventlistener_run;
+		}
 	};
 
 	extern std::vector<Device> all_devices();
@@ -0,0 +1,231 @@
+/*
+    This file is part of SX128x Linux driver.
+    Copyright (C) 2020 ReimuNotMoe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "ReedSolomon.hpp"
+
+#include <stdexcept>
+#include <cstring>
+
+namespace {
+	// Antilog table doubled, so a product needs no modulo
+	struct GfTables {
+		uint8_t Exp[512];
+		uint8_t Log[256];
+
+		constexpr GfTables() : Exp(), Log() {
+			uint16_t x = 1;
+
+			for (uint16_t i = 0; i < 255; i++) {
+				Exp[i] = Exp[i + 255] = (uint8_t)x;
+				Log[x] = (uint8_t)i;
+				x <<= 1;
+				if (x & 0x100) {
+					x ^= 0x11d;
+				}
+			}
+
+			Exp[510] = Exp[0];
+			Exp[511] = Exp[1];
+		}
+	};
+
+	constexpr GfTables Gf;
+
+	inline uint8_t GfMul(uint8_t a, uint8_t b) {
+		return ( a == 0 || b == 0 ) ? 0 : Gf.Exp[Gf.Log[a] + Gf.Log[b]];
+	}
+
+	inline uint8_t GfDiv(uint8_t a, uint8_t b) {
+		return ( a == 0 ) ? 0 : Gf.Exp[Gf.Log[a] + 255 - Gf.Log[b]];
+	}
+
+	inline uint8_t GfPow(uint16_t exponent) {
+		return Gf.Exp[exponent % 255];
+	}
+}
+
+ReedSolomon::ReedSolomon(uint8_t parity) : Parity(parity) {
+	if (parity == 0 || parity >= BLOCK_MAX_SIZE) {
+		throw std::invalid_argument("Reed-Solomon parity must be between 1 and " + std::to_string(BLOCK_MAX_SIZE - 1));
+	}
+
+	// g(x) = (x - a^0)(x - a^1)...(x - a^(parity - 1)), lowest degree first
+	std::vector<uint8_t> generator(parity + 1, 0);
+
+	generator[0] = 1;
+
+	for (uint8_t root = 0; root < parity; root++) {
+		for (int i = root + 1; i > 0; i--) {
+			generator[i] = generator[i - 1] ^ GfMul(generator[i], GfPow(root));
+		}
+		generator[0] = GfMul(generator[0], GfPow(root));
+	}
+
+	// The register holds the highest degree first
+	EncodeTable.resize(256 * parity);
+
+	for (uint16_t feedback = 0; feedback < 256; feedback++) {
+		for (uint8_t i = 0; i < parity; i++) {
+			EncodeTable[feedback * parity + i] = GfMul(feedback, generator[parity - 1 - i]);
+		}
+	}
+
+	RootTable.resize(parity * 256);
+
+	for (uint8_t j = 0; j < parity; j++) {
+		for (uint16_t x = 0; x < 256; x++) {
+			RootTable[j * 256 + x] = GfMul(x, GfPow(j));
+		}
+	}
+}
+
+void ReedSolomon::Encode(const uint8_t *data, size_t size, uint8_t *parity) const {
+	for (size_t i = 0; i < size; i++) {
+		const uint8_t *row = &EncodeTable[( data[i] ^ parity[0] ) * Parity];
+
+		// Each byte waits on the feedback of the one before, only the
+		// shift and XOR of the register can become vector code
+		for (size_t j = 0; j + 1 < Parity; j++) {
+			parity[j] = parity[j + 1] ^ row[j];
+		}
+		parity[Parity - 1] = row[Parity - 1];
+	}
+}
+
+int ReedSolomon::Decode(uint8_t *block, size_t size) const {
+	if (size <= Parity || size > BLOCK_MAX_SIZE) {
+		return -1;
+	}
+
+	uint8_t syndromes[BLOCK_MAX_SIZE] = {};
+	bool clean = true;
+
+	// S(j) = r(a^j) by Horner's rule, the first byte is the highest degree.
+	// Each syndrome is a serial chain of lookups, running them side by side
+	// keeps several lookups in flight instead of waiting on each one.
+	for (size_t i = 0; i < size; i++) {
+		const uint8_t *root = RootTable.data();
+
+		for (uint8_t j = 0; j < Parity; j++, root += 256) {
+			syndromes[j] = root[syndromes[j]] ^ block[i];
+		}
+	}
+
+	for (uint8_t j = 0; j < Parity; j++) {
+		clean = clean && syndromes[j] == 0;
+	}
+
+	if (clean) {
+		return 0;
+	}
+
+	// Berlekamp-Massey, lambda is the error locator polynomial
+	uint8_t lambda[BLOCK_MAX_SIZE + 1] = {1}, previous[BLOCK_MAX_SIZE + 1] = {1}, saved[BLOCK_MAX_SIZE + 1];
+	uint8_t lastDiscrepancy = 1;
+	unsigned int degree = 0, shift = 1;
+
+	for (unsigned int r = 0; r < Parity; r++) {
+		uint8_t discrepancy = syndromes[r];
+
+		for (unsigned int i = 1; i <= degree; i++) {
+			discrepancy ^= GfMul(lambda[i], syndromes[r - i]);
+		}
+
+		if (discrepancy == 0) {
+			shift++;
+			continue;
+		}
+
+		uint8_t scale = GfDiv(discrepancy, lastDiscrepancy);
+
+		if (2 * degree <= r) {
+			memcpy(saved, lambda, Parity + 1);
+			for (unsigned int i = shift; i <= Parity; i++) {
+				lambda[i] ^= GfMul(scale, previous[i - shift]);
+			}
+			degree = r + 1 - degree;
+			memcpy(previous, saved, Parity + 1);
+			lastDiscrepancy = discrepancy;
+			shift = 1;
+		} else {
+			for (unsigned int i = shift; i <= Parity; i++) {
+				lambda[i] ^= GfMul(scale, previous[i - shift]);
+			}
+			shift++;
+		}
+	}
+
+	if (2 * degree > Parity) {
+		return -1;
+	}
+
+	// Error evaluator, omega = S * lambda mod x^parity
+	uint8_t omega[BLOCK_MAX_SIZE] = {};
+
+	for (unsigned int i = 0; i < Parity; i++) {
+		for (unsigned int j = 0; j <= i && j <= degree; j++) {
+			omega[i] ^= GfMul(syndromes[i - j], lambda[j]);
+		}
+	}
+
+	// Chien search over the bytes of the block only, the shortened part is
+	// known to be zero. Forney gives the magnitude of each error.
+	uint8_t positions[BLOCK_MAX_SIZE], magnitudes[BLOCK_MAX_SIZE];
+	unsigned int found = 0;
+
+	for (size_t i = 0; i < size && found < degree; i++) {
+		uint16_t inverse = 255 - ( size - 1 - i );
+		uint8_t value = 0, derivative = 0, evaluator = 0;
+
+		for (unsigned int j = 0; j <= degree; j++) {
+			value ^= GfMul(lambda[j], GfPow(inverse * j));
+			// Formal derivative, odd terms only, one degree lower
+			if (j & 1) {
+				derivative ^= GfMul(lambda[j], GfPow(inverse * ( j - 1 )));
+			}
+		}
+
+		if (value != 0) {
+			continue;
+		}
+
+		for (unsigned int j = 0; j < Parity; j++) {
+			evaluator ^= GfMul(omega[j], GfPow(inverse * j));
+		}
+
+		if (derivative == 0) {
+			return -1;
+		}
+
+		positions[found] = i;
+		magnitudes[found] = GfMul(GfPow(size - 1 - i), GfDiv(evaluator, derivative));
+		found++;
+	}
+
+	// Roots outside the block mean the errors can't be located, the block
+	// is left as received
+	if (found != degree) {
+		return -1;
+	}
+
+	for (unsigned int i = 0; i < found; i++) {
+		block[positions[i]] ^= magnitudes[i];
+	}
+
+	return (int)found;
+}
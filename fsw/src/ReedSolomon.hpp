@@ -0,0 +1,85 @@
+/*
+    This file is part of SX128x Linux driver.
+    Copyright (C) 2020 ReimuNotMoe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include <cstddef>
+#include <cinttypes>
+
+/*!
+ * \brief Reed-Solomon code over GF(256), shortened to the size of a packet
+ *
+ * Field polynomial 0x11d, generator roots alpha^0 to alpha^(parity - 1).
+ * The parity bytes follow the data, a block of parity bytes corrects up to
+ * parity / 2 corrupted bytes anywhere in the block. Blocks are at most 255
+ * bytes.
+ */
+class ReedSolomon {
+public:
+	static constexpr size_t BLOCK_MAX_SIZE = 255;
+
+private:
+	uint8_t Parity;
+
+	/*!
+	 * \brief Row f holds f times the generator coefficients, in register
+	 *        order, so encoding a byte is one row lookup and XOR
+	 */
+	std::vector<uint8_t> EncodeTable;
+
+	/*!
+	 * \brief Row j multiplies by the generator root a^j, for the syndromes
+	 */
+	std::vector<uint8_t> RootTable;
+
+public:
+	/*!
+	 * \param [in]  parity        Parity bytes per block, 1 to 254
+	 */
+	explicit ReedSolomon(uint8_t parity);
+
+	uint8_t GetParity(void) const noexcept {
+		return Parity;
+	}
+
+	/*!
+	 * \brief Runs data through the encoder
+	 *
+	 * The parity register carries over between calls, so data split over
+	 * several buffers is encoded without gathering it first. Zero parity
+	 * before the first call.
+	 *
+	 * \param [in]  data          Data to encode
+	 * \param [in]  size          Data size
+	 * \param [in,out] parity     Parity register, GetParity() bytes
+	 */
+	void Encode(const uint8_t *data, size_t size, uint8_t *parity) const;
+
+	/*!
+	 * \brief Corrects a block in place
+	 *
+	 * \param [in,out] block      Data followed by its parity bytes
+	 * \param [in]  size          Block size, parity included
+	 *
+	 * \retval      corrected     Bytes corrected, -1 if the block has more
+	 *                            errors than the code corrects
+	 */
+	int Decode(uint8_t *block, size_t size) const;
+};
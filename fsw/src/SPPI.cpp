@@ -61,6 +61,31 @@ ssize_t SPPI::write_all(int __fd, const void *__buf, size_t __n) {
 	return written;
 }
 
+void SPPI::lock_device() {
+	if (exclusive_)
+		return;
+
+	errno = 0;
+
+	int rc_lock;
+
+	do {
+		rc_lock = flock(fd, LOCK_EX);
+	} while (errno == EINTR);
+
+	if (rc_lock < 0)
+		throw std::system_error(errno, std::system_category(), "failed to lock device");
+}
+
+void SPPI::unlock_device() {
+	if (exclusive_)
+		return;
+
+	do {
+		flock(fd, LOCK_UN);
+	} while (errno == EINTR);
+}
+
 SPPI::SPPI(const std::string &__device_path, int __mode, int __bits_per_word, int __max_speed_hz) {
 	path_ = __device_path;
 	__init(__mode, __bits_per_word, __max_speed_hz);
@@ -116,6 +141,24 @@ void SPPI::set_max_speed_hz(uint32_t __max_speed_hz) {
 	max_speed_hz_ = __max_speed_hz;
 }
 
+bool SPPI::exclusive() const noexcept {
+	return exclusive_;
+}
+
+void SPPI::set_exclusive(bool __exclusive) {
+	if (__exclusive == exclusive_)
+		return;
+
+	if (__exclusive) {
+		if (flock(fd, LOCK_EX | LOCK_NB) < 0)
+			throw std::system_error(errno, std::system_category(), "failed to lock device exclusively");
+	} else {
+		flock(fd, LOCK_UN);
+	}
+
+	exclusive_ = __exclusive;
+}
+
 uint16_t SPPI::transfer(uint16_t data, bool __cs_change, uint16_t __delay_usecs, uint8_t __word_delay_usecs) {
 	if (bits_per_word_ > 8) {
 		data = htobe16(data);
@@ -143,16 +186,7 @@ void SPPI::transfer(const void *__tx_buf, void *__rx_buf, uint32_t __len, bool _
 	tr.speed_hz = max_speed_hz_;
 	tr.bits_per_word = bits_per_word_;
 
-	errno = 0;
-
-	int rc_lock;
-
-	do {
-		rc_lock = flock(fd, LOCK_EX);
-	} while (errno == EINTR);
-
-	if (rc_lock < 0)
-		throw std::system_error(errno, std::system_category(), "failed to lock device");
+	lock_device();
 
 	if (__cs_change) {
 		if (custom_chip_selector_)
@@ -166,23 +200,40 @@ void SPPI::transfer(const void *__tx_buf, void *__rx_buf, uint32_t __len, bool _
 			custom_chip_selector_(false);
 	}
 
-	do {
-		flock(fd, LOCK_UN);
-	} while (errno == EINTR);
+	unlock_device();
+
+	if (rc_ioc < 0)
+		throw std::system_error(errno, std::system_category(), "failed to transfer");
+}
+
+void SPPI::transfer(std::vector<SPPI_Transfer>& __transfers) {
+	if (__transfers.empty())
+		return;
+
+	for (auto &it : __transfers) {
+		it.speed_hz = max_speed_hz_;
+		it.bits_per_word = bits_per_word_;
+	}
+
+	lock_device();
+
+	if (custom_chip_selector_)
+		custom_chip_selector_(true);
+
+	int rc_ioc = ioctl(fd, SPI_IOC_MESSAGE(__transfers.size()), __transfers.data());
+
+	if (custom_chip_selector_)
+		custom_chip_selector_(false);
+
+	unlock_device();
 
 	if (rc_ioc < 0)
 		throw std::system_error(errno, std::system_category(), "failed to transfer");
 }
 
-//void SPPI::transfer(std::vector<SPPI_Transfer>& __transfers) {
-//	for (auto &it : __transfers) {
-//		it.speed_hz = max_speed_hz_;
-//		it.bits_per_word = bits_per_word_;
-//	}
-//
-//	if (ioctl(fd, SPI_IOC_MESSAGE(__transfers.size()), __transfers.data()) < 0)
-//		throw std::system_error(errno, std::system_category(), "failed to transfer");
-//}
+void SPPI::transfer(SPPI_TransferList& __transfers) {
+	transfer(__transfers.transfers());
+}
 
 void SPPI::send(const void *__tx_buf, uint32_t __len) {
 	if (write_all(fd, __tx_buf, __len) < 0)
@@ -196,12 +247,17 @@ void SPPI::recv(void *__rx_buf, uint32_t __len) {
 
 void
 SPPI::write(const void *__tx_buf, uint32_t __len, bool __cs_change, uint16_t __delay_usecs, uint8_t __word_delay_usecs) {
-	std::vector<uint8_t> discard(__len);
-	transfer(__tx_buf, discard.data(), __len, __cs_change, __delay_usecs, __word_delay_usecs);
+	// A null rx_buf makes spidev discard the received bytes
+	transfer(__tx_buf, nullptr, __len, __cs_change, __delay_usecs, __word_delay_usecs);
 }
 
 void SPPI::read(void *__rx_buf, uint32_t __len, uint8_t __pad_value, bool __cs_change, uint16_t __delay_usecs,
 		uint8_t __word_delay_usecs) {
-	std::vector<uint8_t> whatever(__len, __pad_value);
-	transfer(whatever.data(), __rx_buf, __len, __cs_change, __delay_usecs, __word_delay_usecs);
+	// A null tx_buf makes spidev shift out zeros
+	if (__pad_value == 0) {
+		transfer(nullptr, __rx_buf, __len, __cs_change, __delay_usecs, __word_delay_usecs);
+	} else {
+		std::vector<uint8_t> whatever(__len, __pad_value);
+		transfer(whatever.data(), __rx_buf, __len, __cs_change, __delay_usecs, __word_delay_usecs);
+	}
 }
@@ -17,6 +17,7 @@
 #include <vector>
 #include <algorithm>
 #include <functional>
+#include <stdexcept>
 #include <system_error>
 
 #include <cstring>
@@ -48,6 +49,46 @@ namespace YukiWorkshop {
 		}
 	};
 
+	class SPPI_TransferList {
+	protected:
+		std::vector<SPPI_Transfer> transfers_;
+	public:
+		explicit SPPI_TransferList(size_t __capacity = 16) {
+			transfers_.reserve(__capacity);
+		}
+
+		void add(const void *__tx_buf, void *__rx_buf, uint32_t __len, uint16_t __delay_usecs = 0, bool __cs_change = true, uint8_t __word_delay_usecs = 0) {
+			if (transfers_.size() == transfers_.capacity())
+				throw std::length_error("transfer list is full");
+
+			transfers_.emplace_back(__tx_buf, __rx_buf, __len, __delay_usecs, __cs_change, __word_delay_usecs);
+		}
+
+		void clear() noexcept {
+			transfers_.clear();
+		}
+
+		bool empty() const noexcept {
+			return transfers_.empty();
+		}
+
+		size_t size() const noexcept {
+			return transfers_.size();
+		}
+
+		size_t capacity() const noexcept {
+			return transfers_.capacity();
+		}
+
+		SPPI_Transfer& back() {
+			return transfers_.back();
+		}
+
+		std::vector<SPPI_Transfer>& transfers() noexcept {
+			return transfers_;
+		}
+	};
+
 
 	class SPPI {
 	protected:
@@ -59,11 +100,16 @@ namespace YukiWorkshop {
 		uint8_t bits_per_word_ = 0;
 		uint32_t max_speed_hz_ = 0;
 
+		bool exclusive_ = false;
+
 		std::function<void(bool)> custom_chip_selector_;
 
 		void __init(int __mode, int __bits_per_word, int __max_speed_hz);
 
 		static ssize_t write_all(int __fd, const void *__buf, size_t __n);
+
+		void lock_device();
+		void unlock_device();
 	public:
 		explicit SPPI(const std::string& __device_path, int __mode = -1, int __bits_per_word = -1, int __max_speed_hz = -1);
 		SPPI(const std::string& __device_path, std::function<void(bool)> __custom_chip_selector, int __mode = -1, int __bits_per_word = -1, int __max_speed_hz = -1);
@@ -77,9 +123,18 @@ namespace YukiWorkshop {
 		void set_bits_per_word(uint8_t __bits_per_word);
 		void set_max_speed_hz(uint32_t __max_speed_hz);
 
+		// Exclusive owner mode: the device is flock()ed once here and transfers
+		// skip the per-transfer lock. Fails if another owner holds the device.
+		bool exclusive() const noexcept;
+		void set_exclusive(bool __exclusive);
+
 		uint16_t transfer(uint16_t data, bool __cs_change = true, uint16_t __delay_usecs = 0, uint8_t __word_delay_usecs = 0);
 		void transfer(const void *__tx_buf, void *__rx_buf, uint32_t __len, bool __cs_change = true, uint16_t __delay_usecs = 0, uint8_t __word_delay_usecs = 0);
 
+		// Submits all transfers as one SPI message (a single SPI_IOC_MESSAGE(N) ioctl)
+		void transfer(std::vector<SPPI_Transfer>& __transfers);
+		void transfer(SPPI_TransferList& __transfers);
+
 		void write(const void *__tx_buf, uint32_t __len, bool __cs_change = true, uint16_t __delay_usecs = 0, uint8_t __word_delay_usecs = 0);
 
 		void read(void *__rx_buf, uint32_t __len, uint8_t __pad_value = 0, bool __cs_change = true, uint16_t __delay_usecs = 0, uint8_t __word_delay_usecs = 0);
@@ -34,9 +34,11 @@ void SX128x::SetRegistersDefault(void )
 {
    //error: error: comparison of integer expressions of different signedness: ‘int16_t’ {aka ‘short int’} and ‘long unsigned int’
 	//cfs for( int16_t i = 0; i < sizeof( RadioRegsInit ) / sizeof( RadioRegisters_t ); i++ ) {
+   BeginCommandBatch();
    for( long unsigned int i = 0; i < sizeof( RadioRegsInit ) / sizeof( RadioRegisters_t ); i++ ) { //cfs
 		WriteRegister( RadioRegsInit[i].Addr, RadioRegsInit[i].Value );
 	}
+	EndCommandBatch();
 }
 
 uint16_t SX128x::GetFirmwareVersion(void )
@@ -66,7 +68,7 @@ void SX128x::SetSleep(SleepParams_t sleepConfig )
 			( sleepConfig.DataBufferRetention << 1 ) |
 			( sleepConfig.DataRamRetention );
 
-	OperatingMode = MODE_SLEEP;
+	SetOperatingMode( MODE_SLEEP );
 	WriteCommand( RADIO_SET_SLEEP, &sleep, 1 );
 }
 
@@ -77,18 +79,18 @@ void SX128x::SetStandby(RadioStandbyModes_t standbyConfig )
 	WriteCommand( RADIO_SET_STANDBY, ( uint8_t* )&standbyConfig, 1 );
 	if (standbyConfig == STDBY_RC )
 	{
-		OperatingMode = MODE_STDBY_RC;
+		SetOperatingMode( MODE_STDBY_RC );
 	}
 	else
 	{
-		OperatingMode = MODE_STDBY_XOSC;
+		SetOperatingMode( MODE_STDBY_XOSC );
 	}
 }
 
 void SX128x::SetFs(void )
 {
 	WriteCommand( RADIO_SET_FS, 0, 0 );
-	OperatingMode = MODE_FS;
+	SetOperatingMode( MODE_FS );
 }
 
 void SX128x::SetTx(TickTime_t timeout )
@@ -100,6 +102,9 @@ void SX128x::SetTx(TickTime_t timeout )
 	buf[1] = ( uint8_t )( ( timeout.PeriodBaseCount >> 8 ) & 0x00FF );
 	buf[2] = ( uint8_t )( timeout.PeriodBaseCount & 0x00FF );
 
+	// Send the whole sequence in one bus transaction when the HAL allows it
+	BeginCommandBatch();
+
 	ClearIrqStatus( IRQ_RADIO_ALL );
 
 	// If the radio is doing ranging operations, then apply the specific calls
@@ -112,7 +117,9 @@ void SX128x::SetTx(TickTime_t timeout )
 	HalPostRx();
 	HalPreTx();
 	WriteCommand( RADIO_SET_TX, buf, 3 );
-	OperatingMode = MODE_TX;
+
+	EndCommandBatch();
+	SetOperatingMode( MODE_TX );
 }
 
 void SX128x::SetRx(TickTime_t timeout )
@@ -124,6 +131,9 @@ void SX128x::SetRx(TickTime_t timeout )
 	buf[1] = ( uint8_t )( ( timeout.PeriodBaseCount >> 8 ) & 0x00FF );
 	buf[2] = ( uint8_t )( timeout.PeriodBaseCount & 0x00FF );
 
+	// Send the whole sequence in one bus transaction when the HAL allows it
+	BeginCommandBatch();
+
 	ClearIrqStatus( IRQ_RADIO_ALL );
 
 	// If the radio is doing ranging operations, then apply the specific calls
@@ -133,10 +143,16 @@ void SX128x::SetRx(TickTime_t timeout )
 		SetRangingRole( RADIO_RANGING_ROLE_SLAVE );
 	}
 
+	// A packet sent before may have left its own length, which would cap
+	// the received packets
+	RestorePayloadLength();
+
 	HalPostTx();
 	HalPreRx();
 	WriteCommand( RADIO_SET_RX, buf, 3 );
-	OperatingMode = MODE_RX;
+
+	EndCommandBatch();
+	SetOperatingMode( MODE_RX );
 }
 
 void SX128x::SetRxDutyCycle(RadioTickSizes_t periodBase, uint16_t periodBaseCountRx, uint16_t periodBaseCountSleep )
@@ -152,7 +168,7 @@ void SX128x::SetRxDutyCycle(RadioTickSizes_t periodBase, uint16_t periodBaseCoun
 	HalPostTx();
 	HalPreRx();
 	WriteCommand( RADIO_SET_RXDUTYCYCLE, buf, 5 );
-	OperatingMode = MODE_RX;
+	SetOperatingMode( MODE_RX );
 }
 
 void SX128x::SetCad(void )
@@ -162,7 +178,7 @@ void SX128x::SetCad(void )
 	HalPostTx();
 	HalPreRx();
 	WriteCommand( RADIO_SET_CAD, 0, 0 );
-	OperatingMode = MODE_CAD;
+	SetOperatingMode( MODE_CAD );
 }
 
 void SX128x::SetTxContinuousWave(void )
@@ -235,7 +251,7 @@ void SX128x::SetTxParams(int8_t power, RadioRampTimes_t rampTime )
 void SX128x::SetCadParams(RadioLoRaCadSymbols_t cadSymbolNum )
 {
 	WriteCommand( RADIO_SET_CADPARAMS, ( uint8_t* )&cadSymbolNum, 1 );
-	OperatingMode = MODE_CAD;
+	SetOperatingMode( MODE_CAD );
 }
 
 void SX128x::SetBufferBaseAddresses(uint8_t txBaseAddress, uint8_t rxBaseAddress )
@@ -245,6 +261,9 @@ void SX128x::SetBufferBaseAddresses(uint8_t txBaseAddress, uint8_t rxBaseAddress
 	buf[0] = txBaseAddress;
 	buf[1] = rxBaseAddress;
 	WriteCommand( RADIO_SET_BUFFERBASEADDRESS, buf, 2 );
+
+	TxBaseAddress = txBaseAddress;
+	RxBaseAddress = rxBaseAddress;
 }
 
 void SX128x::SetModulationParams(const ModulationParams_t& modParams )
@@ -292,9 +311,22 @@ void SX128x::SetModulationParams(const ModulationParams_t& modParams )
 	CurrentModParams = modParams;
 }
 
-void SX128x::SetPacketParams(const PacketParams_t& packetParams)
+void SX128x::SetPacketParams(const PacketParams_t& requestedParams)
+{
+	WritePacketParams( requestedParams );
+	CurrentPacketParams = requestedParams;
+}
+
+void SX128x::WritePacketParams(const PacketParams_t& requestedParams)
 {
 	uint8_t buf[7];
+	PacketParams_t packetParams = requestedParams;
+
+	// The FEC replaces the CRC, the requested one comes back without it
+	if (FecParity) {
+		DisablePacketCrc( packetParams );
+	}
+
 	// Check if required configuration corresponds to the stored packet type
 	// If not, silently update radio packet type
 	if (this->PacketType != packetParams.PacketType )
@@ -352,7 +384,7 @@ void SX128x::SetPacketParams(const PacketParams_t& packetParams)
 			break;
 	}
 	WriteCommand( RADIO_SET_PACKETPARAMS, buf, 7 );
-	CurrentPacketParams = packetParams;
+	SentPayloadLength = GetPacketPayloadLength( packetParams );
 }
 
 void SX128x::ForcePreambleLength(RadioPreambleLengths_t preambleLength )
@@ -483,7 +515,34 @@ void SX128x::SetDioIrqParams(uint16_t irqMask, uint16_t dio1Mask, uint16_t dio2M
 	buf[5] = ( uint8_t )( dio2Mask & 0x00FF );
 	buf[6] = ( uint8_t )( ( dio3Mask >> 8 ) & 0x00FF );
 	buf[7] = ( uint8_t )( dio3Mask & 0x00FF );
+
+	std::lock_guard<std::mutex> lg(IOLock2);
+
 	WriteCommand( RADIO_SET_DIOIRQPARAMS, buf, 8 );
+
+	IrqMask = irqMask;
+	DioIrqMasks[0] = dio1Mask & irqMask;
+	DioIrqMasks[1] = dio2Mask & irqMask;
+	DioIrqMasks[2] = dio3Mask & irqMask;
+	DioIrqRouting = false;
+}
+
+void SX128x::SetDioIrqRouting(uint16_t dio1Irqs, uint16_t dio2Irqs, uint16_t dio3Irqs )
+{
+	// An IRQ routed to several lines would be cleared by the first edge
+	dio2Irqs &= ~dio1Irqs;
+	dio3Irqs &= ~( dio1Irqs | dio2Irqs );
+
+	SetDioIrqParams( dio1Irqs | dio2Irqs | dio3Irqs, dio1Irqs, dio2Irqs, dio3Irqs );
+
+	std::lock_guard<std::mutex> lg(IOLock2);
+	DioIrqRouting = true;
+}
+
+void SX128x::ClearDioIrqRouting(void )
+{
+	std::lock_guard<std::mutex> lg(IOLock2);
+	DioIrqRouting = false;
 }
 
 uint16_t SX128x::GetIrqStatus(void )
@@ -549,7 +608,7 @@ void SX128x::SetLongPreamble(bool enable )
 	WriteCommand( RADIO_SET_LONGPREAMBLE, ( uint8_t * )&enable, 1 );
 }
 
-void SX128x::SetPayload(uint8_t *buffer, uint8_t size, uint8_t offset )
+void SX128x::SetPayload(const uint8_t *buffer, uint8_t size, uint8_t offset )
 {
 	WriteBuffer( offset, buffer, size );
 }
@@ -880,9 +939,7 @@ double SX128x::GetFrequencyError( )
 	{
 		case PACKET_TYPE_LORA:
 		case PACKET_TYPE_RANGING:
-			efeRaw[0] = this->ReadRegister( REG_LR_ESTIMATED_FREQUENCY_ERROR_MSB );
-			efeRaw[1] = this->ReadRegister( REG_LR_ESTIMATED_FREQUENCY_ERROR_MSB + 1 );
-			efeRaw[2] = this->ReadRegister( REG_LR_ESTIMATED_FREQUENCY_ERROR_MSB + 2 );
+			this->ReadRegister( REG_LR_ESTIMATED_FREQUENCY_ERROR_MSB, efeRaw, 3 );
 			efe = ( efeRaw[0]<<16 ) | ( efeRaw[1]<<8 ) | efeRaw[2];
 			efe &= REG_LR_ESTIMATED_FREQUENCY_ERROR_MASK;
 
@@ -899,10 +956,10 @@ double SX128x::GetFrequencyError( )
 	return efeHz;
 }
 
-//void SX1280::SetPollingMode( void )
-//{
-//	this->PollingMode = true;
-//}
+void SX128x::SetPollingMode(void )
+{
+	this->PollingMode = true;
+}
 
 int32_t SX128x::complement2(const uint32_t num, const uint8_t bitCnt )
 {
@@ -940,285 +997,409 @@ int32_t SX128x::GetLoRaBandwidth( )
 	return bwValue;
 }
 
-//void SX1280::SetInterruptMode( void )
-//{
-//	this->PollingMode = false;
-//}
-
-//void SX1280::OnDioIrq( void )
-//{
-//	/*
-//	 * When polling mode is activated, it is up to the application to call
-//	 * ProcessIrqs( ). Otherwise, the driver automatically calls ProcessIrqs( )
-//	 * on radio interrupt.
-//	 */
-//	if (this->PollingMode == true )
-//	{
-//		this->IrqState = true;
-//	}
-//	else
-//	{
-//		this->ProcessIrqs();
-//	}
-//}
+void SX128x::SetInterruptMode(void )
+{
+	this->PollingMode = false;
+}
 
 void SX128x::ProcessIrqs() {
 	std::unique_lock<std::mutex> lg(IOLock2);
 
-	RadioPacketTypes_t packetType = PACKET_TYPE_NONE;
+	HandleIrqs( lg, IRQ_RADIO_ALL, true );
+}
 
-//	if (this->PollingMode == true )
-//	{
-//		if (this->IrqState == true )
-//		{
-////            __disable_irq();
-//			this->IrqState = false;
-////            __enable_irq();
-//		}
-//		else
-//		{
-//			return;
-//		}
-//	}
+void SX128x::ProcessDioIrq(uint8_t dio) {
+	/*
+	 * When polling mode is activated, it is up to the application to call
+	 * PollIrqs( ). Otherwise, the driver automatically processes the IRQs
+	 * on radio interrupt.
+	 */
+	if (this->PollingMode == true )
+	{
+		this->IrqState = true;
+		return;
+	}
+
+	std::unique_lock<std::mutex> lg(IOLock2);
+
+	uint16_t irqs = ( DioIrqRouting && dio >= 1 && dio <= 3 ) ? DioIrqMasks[dio-1] : ( uint16_t )IRQ_RADIO_NONE;
+
+	// A DIO shared by TX_DONE and RX_DONE is unambiguous while transmitting
+	if (OperatingMode == MODE_TX )
+	{
+		irqs &= ~IRQ_RX_DONE;
+	}
+
+	// RX_DONE and CAD_DONE are qualified by other IRQs, which only the
+	// status tells
+	bool qualified = ( ( irqs & IRQ_RX_DONE ) && ( IrqMask & ( IRQ_CRC_ERROR | IRQ_SYNCWORD_ERROR ) ) ) ||
+			 ( ( irqs & IRQ_CAD_DONE ) && ( IrqMask & IRQ_CAD_DETECTED ) );
+
+	if (irqs == IRQ_RADIO_NONE || ( irqs & ( irqs - 1 ) ) || qualified )
+	{
+		HandleIrqs( lg, IRQ_RADIO_ALL, true );
+	}
+	else
+	{
+		HandleIrqs( lg, irqs, false );
+	}
+}
+
+bool SX128x::PollIrqs(IrqPollSource_t source) {
+	if (this->IrqState.exchange( false ) )
+	{
+		ProcessIrqs();
+		return true;
+	}
+
+	if (source == IRQ_POLL_DIO )
+	{
+		// Bit #0 is BUSY
+		if (( GetDioStatus() & 0x0E ) == 0 )
+		{
+			return false;
+		}
+
+		ProcessIrqs();
+		return true;
+	}
+
+	std::unique_lock<std::mutex> lg(IOLock2);
 
-	packetType = GetPacketType( true );
 	uint16_t irqRegs = GetIrqStatus();
-	ClearIrqStatus( IRQ_RADIO_ALL );
+
+	if (irqRegs == IRQ_RADIO_NONE )
+	{
+		return false;
+	}
+
+	// The status is already known, only what was read gets cleared so IRQs
+	// raised in between are seen by the next poll
+	HandleIrqs( lg, irqRegs, false );
+	return true;
+}
+
+void SX128x::RunIrqPolling(uint32_t periodUs, IrqPollSource_t source) {
+	auto next = std::chrono::steady_clock::now();
+
+	while (!PollingStop) {
+		PollIrqs( source );
+
+		if (periodUs == 0) {
+			continue;
+		}
+
+		// Keep a fixed rate, a late poll doesn't push the next ones back
+		next += std::chrono::microseconds(periodUs);
+
+		auto now = std::chrono::steady_clock::now();
+
+		if (next < now) {
+			next = now;
+		} else {
+			std::this_thread::sleep_until(next);
+		}
+	}
+
+	PollingStop = false;
+}
+
+void SX128x::StopIrqPolling(void) {
+	PollingStop = true;
+}
+
+void SX128x::HandleIrqs(std::unique_lock<std::mutex>& lg, uint16_t clearMask, bool readStatus) {
+	RadioPacketTypes_t packetType = PACKET_TYPE_NONE;
+
+	packetType = GetPacketType( true );
+
+	IrqEvent_t event = {};
+	event.Timestamp = HalGetIrqTimestamp();
+	event.PacketType = packetType;
+	event.OperatingMode = OperatingMode;
+
+	// A packet is likely waiting in RX, so its status is fetched along with
+	// the IRQs in the same burst
+	bool prefetchRx = readStatus ? ( OperatingMode == MODE_RX ) : ( ( clearMask & IRQ_RX_DONE ) != 0 );
+	FetchIrqStatus( clearMask, readStatus, prefetchRx, event );
+
+	if (DispatcherActive )
+	{
+		// Dropped events are counted by the queue
+		IrqQueue.push( event );
+		lg.unlock();
+
+		// Taking the lock orders the push before the dispatcher's empty check
+		{
+			std::lock_guard<std::mutex> dlg(DispatcherLock);
+		}
+		DispatcherCond.notify_one();
+		return;
+	}
 
 	lg.unlock();
 
-	auto& txDone = callbacks.txDone;
-	auto& rxDone = callbacks.rxDone;
-	auto& rxSyncWordDone = callbacks.rxSyncWordDone;
-	auto& rxHeaderDone = callbacks.rxHeaderDone;
-	auto& txTimeout = callbacks.txTimeout;
-	auto& rxTimeout = callbacks.rxTimeout;
-	auto& rxError = callbacks.rxError;
-	auto& rangingDone = callbacks.rangingDone;
-	auto& cadDone = callbacks.cadDone;
-
-//#if (SX1280_DEBUG == 1 )
-//	DigitalOut TEST_PIN_1( D14 );
-//	DigitalOut TEST_PIN_2( D15 );
-//	for( int i = 0x8000; i != 0; i >>= 1 )
-//	{
-//	TEST_PIN_2 = 0;
-//	TEST_PIN_1 = ( ( irqRegs & i ) != 0 ) ? 1 : 0;
-//	TEST_PIN_2 = 1;
-//	}
-//	TEST_PIN_1 = 0;
-//	TEST_PIN_2 = 0;
-//#endif
-
-	switch( packetType )
+	DispatchIrqs( event );
+}
+
+void SX128x::DispatchIrqs(const IrqEvent_t& event) {
+	SetIrqStatusCache( event );
+
+	const IrqDispatchEntry_t *entry = GetIrqDispatchEntry( event.PacketType, event.OperatingMode );
+
+	// Unexpected IRQs are silently ignored
+	if (entry != nullptr && ( event.IrqRegs & entry->Mask ) != 0 )
 	{
-		case PACKET_TYPE_GFSK:
-		case PACKET_TYPE_FLRC:
-		case PACKET_TYPE_BLE:
-			switch( OperatingMode )
+		for( uint8_t i = 0; i < entry->Count; i++ )
+		{
+			const IrqRule_t& rule = entry->Rules[i];
+
+			if (( event.IrqRegs & rule.Trigger ) == rule.Trigger && ( event.IrqRegs & rule.Unless ) == 0 )
 			{
-				case MODE_RX:
-					if (( irqRegs & IRQ_RX_DONE ) == IRQ_RX_DONE )
-					{
-						if (( irqRegs & IRQ_CRC_ERROR ) == IRQ_CRC_ERROR )
-						{
-							if (rxError)
-								rxError(IRQ_CRC_ERROR_CODE);
-						}
-						else if (( irqRegs & IRQ_SYNCWORD_ERROR ) == IRQ_SYNCWORD_ERROR )
-						{
-							if (rxError)
-								rxError(IRQ_SYNCWORD_ERROR_CODE);
-						}
-						else
-						{
-							if (rxDone)
-								rxDone();
-						}
-					}
-					if (( irqRegs & IRQ_SYNCWORD_VALID ) == IRQ_SYNCWORD_VALID )
-					{
-						if (rxSyncWordDone)
-							rxSyncWordDone();
-					}
-					if (( irqRegs & IRQ_SYNCWORD_ERROR ) == IRQ_SYNCWORD_ERROR )
-					{
-						if (rxError)
-							rxError( IRQ_SYNCWORD_ERROR_CODE);
-
-					}
-					if (( irqRegs & IRQ_RX_TX_TIMEOUT ) == IRQ_RX_TX_TIMEOUT )
-					{
-						HalPostRx();
-						if (rxTimeout)
-							rxTimeout();
-					}
-					if (( irqRegs & IRQ_TX_DONE ) == IRQ_TX_DONE )
-					{
-						HalPostTx();
-						if (txDone)
-							txDone();
-					}
-					break;
-				case MODE_TX:
-					if (( irqRegs & IRQ_TX_DONE ) == IRQ_TX_DONE )
-					{
-						HalPostTx();
-						if (txDone)
-							txDone();
-					}
-					if (( irqRegs & IRQ_RX_TX_TIMEOUT ) == IRQ_RX_TX_TIMEOUT )
-					{
-						HalPostTx();
-						if (txTimeout)
-							txTimeout();
-
-					}
-					break;
-				default:
-					// Unexpected IRQ: silently returns
-					break;
+				RunIrqAction( rule.Action );
 			}
+		}
+	}
+
+	ReleaseIrqStatusCache();
+}
+
+namespace {
+	typedef SX128x S;
+
+	template <size_t N>
+	constexpr S::IrqDispatchEntry_t IrqEntry(const S::IrqRule_t (&rules)[N]) {
+		static_assert(N <= sizeof(S::IrqDispatchEntry_t::Rules) / sizeof(S::IrqRule_t), "too many IRQ rules");
+
+		S::IrqDispatchEntry_t entry = {};
+
+		for (size_t i = 0; i < N; i++) {
+			entry.Rules[i] = rules[i];
+			entry.Mask |= rules[i].Trigger | rules[i].Unless;
+		}
+		entry.Count = N;
+
+		return entry;
+	}
+
+	// GFSK, FLRC and BLE
+	constexpr S::IrqRule_t GfskRxRules[] = {
+		{ S::IRQ_RX_DONE | S::IRQ_CRC_ERROR, 0, S::IRQ_ACTION_RX_ERROR_CRC },
+		{ S::IRQ_RX_DONE | S::IRQ_SYNCWORD_ERROR, S::IRQ_CRC_ERROR, S::IRQ_ACTION_RX_ERROR_SYNCWORD },
+		{ S::IRQ_RX_DONE, S::IRQ_CRC_ERROR | S::IRQ_SYNCWORD_ERROR, S::IRQ_ACTION_RX_DONE },
+		{ S::IRQ_SYNCWORD_VALID, 0, S::IRQ_ACTION_RX_SYNCWORD_DONE },
+		{ S::IRQ_SYNCWORD_ERROR, 0, S::IRQ_ACTION_RX_ERROR_SYNCWORD },
+		{ S::IRQ_RX_TX_TIMEOUT, 0, S::IRQ_ACTION_RX_TIMEOUT },
+		{ S::IRQ_TX_DONE, 0, S::IRQ_ACTION_TX_DONE },
+	};
+
+	constexpr S::IrqRule_t TxRules[] = {
+		{ S::IRQ_TX_DONE, 0, S::IRQ_ACTION_TX_DONE },
+		{ S::IRQ_RX_TX_TIMEOUT, 0, S::IRQ_ACTION_TX_TIMEOUT },
+	};
+
+	constexpr S::IrqRule_t LoRaRxRules[] = {
+		{ S::IRQ_RX_DONE | S::IRQ_CRC_ERROR, 0, S::IRQ_ACTION_RX_ERROR_CRC },
+		{ S::IRQ_RX_DONE, S::IRQ_CRC_ERROR, S::IRQ_ACTION_RX_DONE },
+		{ S::IRQ_HEADER_VALID, 0, S::IRQ_ACTION_RX_HEADER_DONE },
+		{ S::IRQ_HEADER_ERROR, 0, S::IRQ_ACTION_RX_ERROR_HEADER },
+		{ S::IRQ_RX_TX_TIMEOUT, 0, S::IRQ_ACTION_RX_TIMEOUT },
+		{ S::IRQ_RANGING_SLAVE_REQUEST_DISCARDED, 0, S::IRQ_ACTION_RX_ERROR_RANGING_ON_LORA },
+		{ S::IRQ_TX_DONE, 0, S::IRQ_ACTION_TX_DONE },                   // AutoTx
+	};
+
+	constexpr S::IrqRule_t LoRaCadRules[] = {
+		{ S::IRQ_CAD_DONE | S::IRQ_CAD_DETECTED, 0, S::IRQ_ACTION_CAD_DETECTED },
+		{ S::IRQ_CAD_DONE, S::IRQ_CAD_DETECTED, S::IRQ_ACTION_CAD_CLEAR },
+		{ S::IRQ_RX_TX_TIMEOUT, S::IRQ_CAD_DONE, S::IRQ_ACTION_RX_TIMEOUT },
+	};
+
+	// MODE_RX indicates an IRQ on the Slave side
+	constexpr S::IrqRule_t RangingRxRules[] = {
+		{ S::IRQ_RANGING_SLAVE_REQUEST_DISCARDED, 0, S::IRQ_ACTION_RANGING_SLAVE_ERROR },
+		{ S::IRQ_RANGING_SLAVE_REQUEST_VALID, 0, S::IRQ_ACTION_RANGING_SLAVE_VALID },
+		{ S::IRQ_RANGING_SLAVE_RESPONSE_DONE, 0, S::IRQ_ACTION_RANGING_SLAVE_VALID },
+		{ S::IRQ_RX_TX_TIMEOUT, 0, S::IRQ_ACTION_RANGING_SLAVE_ERROR },
+		{ S::IRQ_HEADER_VALID, 0, S::IRQ_ACTION_RX_HEADER_DONE },
+		{ S::IRQ_HEADER_ERROR, 0, S::IRQ_ACTION_RX_ERROR_HEADER },
+	};
+
+	// MODE_TX indicates an IRQ on the Master side
+	constexpr S::IrqRule_t RangingTxRules[] = {
+		{ S::IRQ_RANGING_MASTER_TIMEOUT, 0, S::IRQ_ACTION_RANGING_MASTER_ERROR },
+		{ S::IRQ_RANGING_MASTER_RESULT_VALID, 0, S::IRQ_ACTION_RANGING_MASTER_VALID },
+	};
+
+	constexpr S::IrqDispatchEntry_t NoIrqs = {};
+
+	// Indexed by packet type, then by MODE_RX, MODE_TX, MODE_CAD
+	constexpr S::IrqDispatchEntry_t IrqDispatchTable[5][3] = {
+		{ IrqEntry( GfskRxRules ), IrqEntry( TxRules ), NoIrqs },               // PACKET_TYPE_GFSK
+		{ IrqEntry( LoRaRxRules ), IrqEntry( TxRules ), IrqEntry( LoRaCadRules ) }, // PACKET_TYPE_LORA
+		{ IrqEntry( RangingRxRules ), IrqEntry( RangingTxRules ), NoIrqs },     // PACKET_TYPE_RANGING
+		{ IrqEntry( GfskRxRules ), IrqEntry( TxRules ), NoIrqs },               // PACKET_TYPE_FLRC
+		{ IrqEntry( GfskRxRules ), IrqEntry( TxRules ), NoIrqs },               // PACKET_TYPE_BLE
+	};
+}
+
+const SX128x::IrqDispatchEntry_t *SX128x::GetIrqDispatchEntry(RadioPacketTypes_t packetType, RadioOperatingModes_t mode) {
+	if (packetType > PACKET_TYPE_BLE || mode < MODE_RX || mode > MODE_CAD )
+	{
+		return nullptr;
+	}
+
+	const IrqDispatchEntry_t *entry = &IrqDispatchTable[packetType][mode - MODE_RX];
+
+	return entry->Count ? entry : nullptr;
+}
+
+void SX128x::RunIrqAction(IrqAction_t action) {
+	switch( action )
+	{
+		case IRQ_ACTION_TX_DONE:
+			HalPostTx();
+			if (!CompleteTx( false ) && !RearmTurnaround())
+				ResumeContinuousRx();
+			if (callbacks.txDone)
+				callbacks.txDone();
 			break;
-		case PACKET_TYPE_LORA:
-			switch( OperatingMode )
-			{
-				case MODE_RX:
-					if (( irqRegs & IRQ_RX_DONE ) == IRQ_RX_DONE )
-					{
-						if (( irqRegs & IRQ_CRC_ERROR ) == IRQ_CRC_ERROR )
-						{
-							if (rxError)
-								rxError(IRQ_CRC_ERROR_CODE);
-						}
-						else
-						{
-							if (rxDone)
-								rxDone();
-						}
-					}
-					if (( irqRegs & IRQ_HEADER_VALID ) == IRQ_HEADER_VALID )
-					{
-						if (rxHeaderDone)
-							rxHeaderDone();
-					}
-					if (( irqRegs & IRQ_HEADER_ERROR ) == IRQ_HEADER_ERROR )
-					{
-						if (rxError)
-							rxError( IRQ_HEADER_ERROR_CODE);
-					}
-					if (( irqRegs & IRQ_RX_TX_TIMEOUT ) == IRQ_RX_TX_TIMEOUT )
-					{
-						HalPostRx();
-						if (rxTimeout)
-							rxTimeout();
-					}
-					if (( irqRegs & IRQ_RANGING_SLAVE_REQUEST_DISCARDED ) == IRQ_RANGING_SLAVE_REQUEST_DISCARDED )
-					{
-						if (rxError)
-							rxError( IRQ_RANGING_ON_LORA_ERROR_CODE);
-					}
-					break;
-				case MODE_TX:
-					if (( irqRegs & IRQ_TX_DONE ) == IRQ_TX_DONE )
-					{
-						HalPostTx();
-						if (txDone)
-							txDone();
-					}
-					if (( irqRegs & IRQ_RX_TX_TIMEOUT ) == IRQ_RX_TX_TIMEOUT )
-					{
-						HalPostTx();
-						if (txTimeout)
-							txTimeout();
-					}
-					break;
-				case MODE_CAD:
-					if (( irqRegs & IRQ_CAD_DONE ) == IRQ_CAD_DONE )
-					{
-						if (( irqRegs & IRQ_CAD_DETECTED ) == IRQ_CAD_DETECTED )
-						{
-							if (cadDone)
-								cadDone( true );
-						}
-						else
-						{
-							if (cadDone)
-								cadDone( false );
-						}
-					}
-					else if (( irqRegs & IRQ_RX_TX_TIMEOUT ) == IRQ_RX_TX_TIMEOUT )
-					{
-						HalPostRx();
-						if (rxTimeout)
-							rxTimeout();
-					}
-					break;
-				default:
-					// Unexpected IRQ: silently returns
-					break;
-			}
+		case IRQ_ACTION_TX_TIMEOUT:
+			HalPostTx();
+			if (!CompleteTx( true ) && !RearmTurnaround())
+				ResumeContinuousRx();
+			if (callbacks.txTimeout)
+				callbacks.txTimeout();
 			break;
-		case PACKET_TYPE_RANGING:
-			switch( OperatingMode )
-			{
-				// MODE_RX indicates an IRQ on the Slave side
-				case MODE_RX:
-					if (( irqRegs & IRQ_RANGING_SLAVE_REQUEST_DISCARDED ) == IRQ_RANGING_SLAVE_REQUEST_DISCARDED )
-					{
-						if (rangingDone)
-							rangingDone(IRQ_RANGING_SLAVE_ERROR_CODE);
-					}
-					if (( irqRegs & IRQ_RANGING_SLAVE_REQUEST_VALID ) == IRQ_RANGING_SLAVE_REQUEST_VALID )
-					{
-						if (rangingDone)
-							rangingDone(IRQ_RANGING_SLAVE_VALID_CODE);
-					}
-					if (( irqRegs & IRQ_RANGING_SLAVE_RESPONSE_DONE ) == IRQ_RANGING_SLAVE_RESPONSE_DONE )
-					{
-						if (rangingDone)
-							rangingDone(IRQ_RANGING_SLAVE_VALID_CODE);
-					}
-					if (( irqRegs & IRQ_RX_TX_TIMEOUT ) == IRQ_RX_TX_TIMEOUT )
-					{
-						if (rangingDone)
-							rangingDone(IRQ_RANGING_SLAVE_ERROR_CODE);
-					}
-					if (( irqRegs & IRQ_HEADER_VALID ) == IRQ_HEADER_VALID )
-					{
-						if (rxHeaderDone)
-							rxHeaderDone();
-					}
-					if (( irqRegs & IRQ_HEADER_ERROR ) == IRQ_HEADER_ERROR )
-					{
-						if (rxError)
-							rxError(IRQ_HEADER_ERROR_CODE);
-					}
-					break;
-					// MODE_TX indicates an IRQ on the Master side
-				case MODE_TX:
-					if (( irqRegs & IRQ_RANGING_MASTER_TIMEOUT ) == IRQ_RANGING_MASTER_TIMEOUT )
-					{
-						HalPostTx();
-						if (rangingDone)
-							rangingDone(IRQ_RANGING_MASTER_ERROR_CODE);
-					}
-					if (( irqRegs & IRQ_RANGING_MASTER_RESULT_VALID ) == IRQ_RANGING_MASTER_RESULT_VALID )
-					{
-						HalPostTx();
-						if (rangingDone)
-							rangingDone(IRQ_RANGING_MASTER_VALID_CODE);
-					}
-					break;
-				default:
-					// Unexpected IRQ: silently returns
-					break;
-			}
+		case IRQ_ACTION_RX_DONE:
+			if (TurnaroundArmed)
+				StartTurnaroundTx();
+			if (RxSessionActive)
+				TrackRxBuffer();
+			if (RxRingActive)
+				StoreRxPacket();
+			if (callbacks.rxDone)
+				callbacks.rxDone();
 			break;
-		default:
-			// Unexpected IRQ: silently returns
+		case IRQ_ACTION_RX_TIMEOUT:
+			HalPostRx();
+			if (callbacks.rxTimeout)
+				callbacks.rxTimeout();
+			break;
+		case IRQ_ACTION_RX_SYNCWORD_DONE:
+			if (callbacks.rxSyncWordDone)
+				callbacks.rxSyncWordDone();
+			break;
+		case IRQ_ACTION_RX_HEADER_DONE:
+			if (callbacks.rxHeaderDone)
+				callbacks.rxHeaderDone();
+			break;
+		case IRQ_ACTION_RX_ERROR_CRC:
+			if (callbacks.rxError)
+				callbacks.rxError( IRQ_CRC_ERROR_CODE );
+			break;
+		case IRQ_ACTION_RX_ERROR_SYNCWORD:
+			if (callbacks.rxError)
+				callbacks.rxError( IRQ_SYNCWORD_ERROR_CODE );
+			break;
+		case IRQ_ACTION_RX_ERROR_HEADER:
+			if (callbacks.rxError)
+				callbacks.rxError( IRQ_HEADER_ERROR_CODE );
 			break;
+		case IRQ_ACTION_RX_ERROR_RANGING_ON_LORA:
+			if (callbacks.rxError)
+				callbacks.rxError( IRQ_RANGING_ON_LORA_ERROR_CODE );
+			break;
+		case IRQ_ACTION_CAD_DETECTED:
+			if (callbacks.cadDone)
+				callbacks.cadDone( true );
+			break;
+		case IRQ_ACTION_CAD_CLEAR:
+			if (callbacks.cadDone)
+				callbacks.cadDone( false );
+			break;
+		case IRQ_ACTION_RANGING_SLAVE_ERROR:
+			if (callbacks.rangingDone)
+				callbacks.rangingDone( IRQ_RANGING_SLAVE_ERROR_CODE );
+			break;
+		case IRQ_ACTION_RANGING_SLAVE_VALID:
+			if (callbacks.rangingDone)
+				callbacks.rangingDone( IRQ_RANGING_SLAVE_VALID_CODE );
+			break;
+		case IRQ_ACTION_RANGING_MASTER_ERROR:
+			HalPostTx();
+			if (callbacks.rangingDone)
+				callbacks.rangingDone( IRQ_RANGING_MASTER_ERROR_CODE );
+			break;
+		case IRQ_ACTION_RANGING_MASTER_VALID:
+			HalPostTx();
+			if (callbacks.rangingDone)
+				callbacks.rangingDone( IRQ_RANGING_MASTER_VALID_CODE );
+			break;
+	}
+}
+
+bool SX128x::IsIrqActionHandled(IrqAction_t action) {
+	switch( action )
+	{
+		// These switch the RF path back, whatever the callbacks
+		case IRQ_ACTION_TX_DONE:
+		case IRQ_ACTION_TX_TIMEOUT:
+		case IRQ_ACTION_RX_TIMEOUT:
+		case IRQ_ACTION_RANGING_MASTER_ERROR:
+		case IRQ_ACTION_RANGING_MASTER_VALID:
+			return true;
+		case IRQ_ACTION_RX_DONE:
+			return bool( callbacks.rxDone ) || RxRingActive;
+		case IRQ_ACTION_RX_SYNCWORD_DONE:
+			return bool( callbacks.rxSyncWordDone );
+		case IRQ_ACTION_RX_HEADER_DONE:
+			return bool( callbacks.rxHeaderDone );
+		case IRQ_ACTION_RX_ERROR_CRC:
+		case IRQ_ACTION_RX_ERROR_SYNCWORD:
+		case IRQ_ACTION_RX_ERROR_HEADER:
+		case IRQ_ACTION_RX_ERROR_RANGING_ON_LORA:
+			return bool( callbacks.rxError );
+		case IRQ_ACTION_CAD_DETECTED:
+		case IRQ_ACTION_CAD_CLEAR:
+			return bool( callbacks.cadDone );
+		case IRQ_ACTION_RANGING_SLAVE_ERROR:
+		case IRQ_ACTION_RANGING_SLAVE_VALID:
+			return bool( callbacks.rangingDone );
+	}
+
+	return false;
+}
+
+uint16_t SX128x::GetHandledIrqMask(RadioPacketTypes_t packetType) {
+	uint16_t mask = IRQ_RADIO_NONE;
+
+	for (auto mode : { MODE_RX, MODE_TX, MODE_CAD } )
+	{
+		const IrqDispatchEntry_t *entry = GetIrqDispatchEntry( packetType, mode );
+
+		if (entry == nullptr )
+		{
+			continue;
+		}
+
+		for( uint8_t i = 0; i < entry->Count; i++ )
+		{
+			// The Unless IRQs must be raised too, or a failed reception
+			// would look like a good one
+			if (IsIrqActionHandled( entry->Rules[i].Action ) )
+			{
+				mask |= entry->Rules[i].Trigger | entry->Rules[i].Unless;
+			}
+		}
 	}
+
+	return mask;
+}
+
+void SX128x::SetDioIrqParamsAuto(void) {
+	uint16_t mask = GetHandledIrqMask( GetPacketType( true ) );
+
+	SetDioIrqParams( mask, mask, IRQ_RADIO_NONE, IRQ_RADIO_NONE );
 }
 
 uint16_t SX128x::GetTimeOnAir(const SX128x::ModulationParams_t &modparams, const SX128x::PacketParams_t &pktparams) {
@@ -1352,7 +1533,9 @@ uint16_t SX128x::GetTimeOnAir(const SX128x::ModulationParams_t &modparams, const
 				break;
 		}
 
+#ifdef PRINT_DEBUG
 		printf( "ToA FLRC: %f \n\r", tPayload );
+#endif
 
 		result = ceil( tPayload );
 	}
@@ -1418,151 +1601,1152 @@ uint16_t SX128x::GetTimeOnAir(const SX128x::ModulationParams_t &modparams, const
 }
 
 uint16_t SX128x::GetTimeOnAir() {
-	return GetTimeOnAir(CurrentModParams, CurrentPacketParams);
+	PacketParams_t params = CurrentPacketParams;
+
+	if (FecParity) {
+		DisablePacketCrc(params);
+	}
+
+	return GetTimeOnAir(CurrentModParams, params);
+}
+
+uint16_t SX128x::GetTimeOnAir(uint8_t size) {
+	PacketParams_t params = CurrentPacketParams;
+
+	SetPacketPayloadLength(params, size);
+
+	if (FecParity) {
+		DisablePacketCrc(params);
+	}
+
+	return GetTimeOnAir(CurrentModParams, params);
 }
 
 
 void SX128x::HalSpiRead(uint8_t *buffer_in, uint16_t size) {
-   //cfs error: ISO C++ forbids variable length array ‘useless’
-	//cfs todo: Create a static size solution
-   //cfs uint8_t useless[size];
-	//cfs memset(useless, 0, size);
-   uint8_t useless[1024];     //cfs
-	memset(useless, 0, 1024);  //cfs
-	HalSpiTransfer(buffer_in, useless, size);
+	HalSpiTransfer(buffer_in, nullptr, size);
 }
 
 void SX128x::HalSpiWrite(const uint8_t *buffer_out, uint16_t size) {
-   //cfs error: ISO C++ forbids variable length array ‘useless’
-	//uint8_t useless[size];
-   //cfs todo: Create a static size solution
-   uint8_t useless[1024];     //cfs
-	HalSpiTransfer(useless, buffer_out, size);
+	HalSpiTransfer(nullptr, buffer_out, size);
 }
 
-void SX128x::WaitOnBusy() {
-	while (HalGpioRead(GPIO_PIN_BUSY)) {
-		std::this_thread::sleep_for(std::chrono::microseconds(10));
+void SX128x::HalSpiTransferBatch(uint8_t *buffer_in, const uint8_t *buffer_out, const uint16_t *sizes, uint16_t count) {
+	for (uint16_t i = 0; i < count; i++) {
+		if (i > 0) {
+			WaitOnBusy();
+		}
+
+		HalSpiTransfer(buffer_in, buffer_out, sizes[i]);
+		if (buffer_in) {
+			buffer_in += sizes[i];
+		}
+		buffer_out += sizes[i];
 	}
 }
 
-void SX128x::WaitOnBusyLong() {
-	while (HalGpioRead(GPIO_PIN_BUSY)) {
-		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+void SX128x::HalSpiTransferChained(const uint8_t *header, uint16_t header_size, uint8_t *data_in, const uint8_t *data_out, uint16_t data_size) {
+	if (data_out) {
+		memcpy(SpiTx, header, header_size);
+		memcpy(SpiTx+header_size, data_out, data_size);
+
+		HalSpiTransfer(nullptr, SpiTx, header_size+data_size);
+	} else {
+		SetReadHeader(header[0], header_size > 1 ? header[1] : 0, header_size > 2 ? header[2] : 0, header_size > 3 ? header[3] : 0);
+
+		HalSpiTransfer(SpiRx, SpiTxNop, header_size+data_size);
+
+		memcpy(data_in, SpiRx+header_size, data_size);
 	}
 }
 
-void SX128x::Reset(void) {
+void SX128x::BeginCommandBatch(void) {
 	std::lock_guard<std::mutex> lg(IOLock);
 
-	HalGpioWrite(GPIO_PIN_RESET, 0);
-	std::this_thread::sleep_for(std::chrono::milliseconds(10));
-	HalGpioWrite(GPIO_PIN_RESET, 1);
-	std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
+	if (BatchDepth == 0) {
+		BatchOwner = std::this_thread::get_id();
+		BatchDepth = 1;
+	} else if (BatchOwner == std::this_thread::get_id()) {
+		BatchDepth++;
+	}
+	// else: another thread owns the batch, commands of this thread go out directly
 }
 
-void SX128x::Wakeup(void) {
+void SX128x::EndCommandBatch(void) {
 	std::lock_guard<std::mutex> lg(IOLock);
 
-	if (SX1280_DEBUG) {
-		printf("SX1280: Wakeup\n");
+	if (BatchDepth == 0 || BatchOwner != std::this_thread::get_id()) {
+		return;
 	}
 
-	uint8_t buf[2] = {RADIO_GET_STATUS, 0};
+	BatchDepth--;
 
-	HalSpiWrite(buf, 2);
+	if (BatchDepth == 0) {
+		FlushCommandBatch();
+	}
+}
 
-	// Wait for chip to be ready.
-	WaitOnBusyLong();
+bool SX128x::BatchCommand(const uint8_t *header, uint16_t headerSize, const uint8_t *buffer, uint16_t size) {
+	if (BatchDepth == 0 || BatchOwner != std::this_thread::get_id()) {
+		return false;
+	}
 
-	if (SX1280_DEBUG) {
-		printf("SX1280: Wakeup done\n");
+	uint16_t total_size = headerSize + size;
+
+	if (total_size > BATCH_BUFFER_SIZE) {
+		return false;
 	}
-}
 
-void SX128x::WriteCommand(SX128x::RadioCommands_t opcode, uint8_t *buffer, uint16_t size) {
-	auto *merged_buf = (uint8_t *)alloca(size+1);
+	if (BatchCount == BATCH_MAX_COMMANDS || BatchLength + total_size > BATCH_BUFFER_SIZE) {
+		FlushCommandBatch();
+	}
 
-	merged_buf[0] = opcode;
-	memcpy(merged_buf+1, buffer, size);
+	memcpy(BatchTx+BatchLength, header, headerSize);
+	if (size) {
+		memcpy(BatchTx+BatchLength+headerSize, buffer, size);
+	}
 
-	std::lock_guard<std::mutex> lg(IOLock);
+	BatchSizes[BatchCount++] = total_size;
+	BatchLength += total_size;
 
-	if (SX1280_DEBUG) {
-		printf("SX1280: WriteCommand: 0x%02x %u\n", opcode, size);
+	return true;
+}
+
+void SX128x::FlushCommandBatch(void) {
+	if (BatchCount == 0) {
+		return;
 	}
 
-	WaitOnBusy();
+	uint16_t count = BatchCount;
 
-	HalSpiWrite(merged_buf, size+1);
+	BatchCount = 0;
+	BatchLength = 0;
 
 	if (SX1280_DEBUG) {
-		printf("SX1280: WriteCommand: send done\n");
+		printf("SX1280: FlushCommandBatch: %u commands\n", count);
 	}
 
-	if (opcode != RADIO_SET_SLEEP) {
-		WaitOnBusy();
-		if (SX1280_DEBUG) {
-			printf("SX1280: WriteCommand: wait done\n");
-		}
-	}
-}
+	PrepareCommand();
 
-void SX128x::ReadCommand(SX128x::RadioCommands_t opcode, uint8_t *buffer, uint16_t size) {
-	std::lock_guard<std::mutex> lg(IOLock);
+	HalSpiTransferBatch(nullptr, BatchTx, BatchSizes, count);
 
-	WaitOnBusy();
+	CompleteCommand();
+}
 
-	if (opcode == RADIO_GET_STATUS) {
-		uint8_t buf_out[3] = {static_cast<uint8_t>(opcode), 0, 0};
-		uint8_t buf_in[3];
+void SX128x::FetchIrqStatus(uint16_t clearMask, bool readStatus, bool prefetchRx, IrqEvent_t& event) {
+	std::lock_guard<std::mutex> lg(IOLock);
 
-		HalSpiTransfer(buf_in, buf_out, 3);
-		buffer[0] = buf_in[0];
-	} else {
-		auto total_transfer_size = 2+size;
+	FlushCommandBatch();
 
-		auto *buf_out = (uint8_t *)alloca(total_transfer_size);
-		auto *buf_in = (uint8_t *)alloca(total_transfer_size);
+	// Up to GET_IRQSTATUS, CLR_IRQSTATUS, GET_RXBUFFERSTATUS, GET_PACKETSTATUS
+	uint16_t sizes[4];
+	uint16_t count = 0, length = 0;
+	uint16_t statusAt = 0, rxBufferStatusAt = 0, packetStatusAt = 0;
 
-		memset(buf_out, 0, total_transfer_size);
-		buf_out[0] = opcode;
+	memset(SpiTx, 0, 18);
 
-		HalSpiTransfer(buf_in, buf_out, total_transfer_size);
-		memcpy(buffer, buf_in+2, size);
-	}
+	auto add = [&](uint8_t opcode, uint16_t size) {
+		uint16_t at = length;
 
-	WaitOnBusy();
-}
+		SpiTx[at] = opcode;
+		sizes[count++] = size;
+		length += size;
 
-void SX128x::WriteRegister(uint16_t address, uint8_t *buffer, uint16_t size) {
-	std::lock_guard<std::mutex> lg(IOLock);
+		return at;
+	};
 
-	if (SX1280_DEBUG) {
-		printf("SX1280: WriteRegister: 0x%04x %u\n", address, size);
+	if (readStatus) {
+		statusAt = add(RADIO_GET_IRQSTATUS, 4);
 	}
 
-	WaitOnBusy();
+	uint16_t clearAt = add(RADIO_CLR_IRQSTATUS, 3);
+	SpiTx[clearAt+1] = ( uint8_t )( ( clearMask >> 8 ) & 0x00FF );
+	SpiTx[clearAt+2] = ( uint8_t )( clearMask & 0x00FF );
 
-	auto total_transfer_size = 3+size;
-	auto *buf_out = (uint8_t *)alloca(total_transfer_size);
+	if (prefetchRx) {
+		rxBufferStatusAt = add(RADIO_GET_RXBUFFERSTATUS, 4);
+		packetStatusAt = add(RADIO_GET_PACKETSTATUS, 7);
+	}
 
-	buf_out[0] = RADIO_WRITE_REGISTER;
-	buf_out[1] = ((address & 0xFF00) >> 8);
-	buf_out[2] = (address & 0x00FF);
-	memcpy(buf_out+3, buffer, size);
+	PrepareCommand();
 
-	HalSpiWrite(buf_out, total_transfer_size);
+	HalSpiTransferBatch(SpiRx, SpiTx, sizes, count);
 
-	if (SX1280_DEBUG) {
-		printf("SX1280: WriteRegister: send done\n");
-	}
+	CompleteCommand();
 
-	WaitOnBusy();
+	event.IrqRegs = readStatus ? ( ( SpiRx[statusAt+2] << 8 ) | SpiRx[statusAt+3] ) : clearMask;
+	event.HasRxStatus = prefetchRx;
 
-	if (SX1280_DEBUG) {
-		printf("SX1280: WriteRegister: Wait done\n");
+	if (prefetchRx) {
+		memcpy(event.RxBufferStatus, SpiRx+rxBufferStatusAt+2, 2);
+		memcpy(event.PacketStatus, SpiRx+packetStatusAt+2, 5);
+	}
+}
+
+void SX128x::SetIrqStatusCache(const IrqEvent_t& event) {
+	std::lock_guard<std::mutex> lg(IOLock);
+
+	DispatchTimestamp = event.Timestamp;
+
+	if (event.HasRxStatus) {
+		memcpy(IrqCacheRxBufferStatus, event.RxBufferStatus, 2);
+		memcpy(IrqCachePacketStatus, event.PacketStatus, 5);
+		IrqCacheOwner = std::this_thread::get_id();
+		IrqCacheValid = true;
+	} else {
+		IrqCacheValid = false;
+	}
+}
+
+void SX128x::ReleaseIrqStatusCache(void) {
+	std::lock_guard<std::mutex> lg(IOLock);
+
+	IrqCacheValid = false;
+}
+
+uint64_t SX128x::HalGetIrqTimestamp() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t SX128x::GetIrqTimestamp(void) {
+	std::lock_guard<std::mutex> lg(IOLock);
+
+	return DispatchTimestamp;
+}
+
+void SX128x::RunCallbackDispatcher(size_t queueSize) {
+	std::unique_lock<std::mutex> lg(IOLock2);
+
+	if (DispatcherActive) {
+		throw std::logic_error("SX1280: callback dispatcher already running");
+	}
+
+	IrqQueue.reset(queueSize);
+	DispatcherActive = true;
+
+	lg.unlock();
+
+	IrqEvent_t event;
+
+	while (true) {
+		while (IrqQueue.pop(event)) {
+			DispatchIrqs(event);
+		}
+
+		std::unique_lock<std::mutex> dlg(DispatcherLock);
+
+		DispatcherCond.wait(dlg, [this]{
+			return !IrqQueue.empty() || DispatcherStop;
+		});
+
+		if (DispatcherStop) {
+			DispatcherStop = false;
+			break;
+		}
+	}
+
+	// IRQs handled from now on run their callbacks inline, the events queued
+	// before are still delivered
+	lg.lock();
+	DispatcherActive = false;
+	lg.unlock();
+
+	while (IrqQueue.pop(event)) {
+		DispatchIrqs(event);
+	}
+}
+
+void SX128x::StopCallbackDispatcher(void) {
+	{
+		std::lock_guard<std::mutex> dlg(DispatcherLock);
+		DispatcherStop = true;
+	}
+	DispatcherCond.notify_one();
+}
+
+SX128x::DispatcherStats_t SX128x::GetDispatcherStats(void) {
+	return { IrqQueue.capacity(), IrqQueue.size(), IrqQueue.high_water_mark(), IrqQueue.drops() };
+}
+
+void SX128x::EnableRxPacketRing(size_t slots) {
+	RxRing.reset(slots);
+	RxRingReceived = 0;
+	RxRingActive = true;
+}
+
+void SX128x::DisableRxPacketRing(void) {
+	RxRingActive = false;
+}
+
+void SX128x::StoreRxPacket(void) {
+	RxPacket_t *packet = RxRing.claim();
+
+	// The packet is left in the radio buffer, the ring counts the overflow
+	if (packet == nullptr) {
+		return;
+	}
+
+	uint8_t offset;
+	PacketStatus_t status;
+
+	// Both are served from the status prefetched with the IRQs when possible
+	GetRxBufferStatus(&packet->Size, &offset);
+	GetPacketStatus(&status);
+
+	packet->Timestamp = GetIrqTimestamp();
+	packet->PacketType = status.packetType;
+	packet->Snr = 0;
+	packet->FrequencyError = 0;
+
+	switch (status.packetType) {
+		case PACKET_TYPE_LORA:
+		case PACKET_TYPE_RANGING:
+			packet->Rssi = status.LoRa.RssiPkt;
+			packet->Snr = status.LoRa.SnrPkt;
+			packet->FrequencyError = (int32_t)GetFrequencyError();
+			break;
+		case PACKET_TYPE_GFSK:
+			packet->Rssi = status.Gfsk.RssiSync;
+			break;
+		case PACKET_TYPE_FLRC:
+			packet->Rssi = status.Flrc.RssiSync;
+			break;
+		case PACKET_TYPE_BLE:
+			packet->Rssi = status.Ble.RssiSync;
+			break;
+		default:
+			packet->Rssi = 0;
+			break;
+	}
+
+	ReadBuffer(offset, packet->Payload, packet->Size);
+
+	// The CRC is off with the FEC, a packet it can't correct goes no further
+	std::shared_ptr<const ReedSolomon> fec = GetFec();
+
+	if (fec) {
+		int corrected = fec->Decode(packet->Payload, packet->Size);
+
+		if (corrected < 0) {
+			RxFecFailures++;
+			return;
+		}
+
+		RxFecCorrected += corrected;
+		packet->Size -= fec->GetParity();
+	}
+
+	{
+		std::lock_guard<std::mutex> lg(RxRingLock);
+		RxRing.commit();
+	}
+	RxRingReceived++;
+	RxRingCond.notify_one();
+}
+
+bool SX128x::ReceivePacket(RxPacket_t& packet, uint32_t timeoutMs) {
+	if (RxRing.pop(packet)) {
+		return true;
+	}
+
+	if (timeoutMs == 0) {
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lg(RxRingLock);
+
+	if (!RxRingCond.wait_for(lg, std::chrono::milliseconds(timeoutMs), [this]{ return !RxRing.empty(); })) {
+		return false;
+	}
+
+	lg.unlock();
+
+	return RxRing.pop(packet);
+}
+
+SX128x::RxRingStats_t SX128x::GetRxRingStats(void) {
+	return { RxRing.capacity(), RxRing.size(), RxRing.high_water_mark(), RxRingReceived, RxRing.drops(), RxFecCorrected, RxFecFailures };
+}
+
+void SX128x::EnableTxQueue(size_t slots) {
+	TxRing.reset(slots);
+	TxQueueSent = 0;
+	TxQueueTimeouts = 0;
+
+	{
+		std::lock_guard<std::mutex> lg(TxQueueLock);
+		TxInFlight = false;
+		TxFromSource = false;
+		TxPreloaded = false;
+	}
+
+	std::unique_lock<std::mutex> lg(IOLock2);
+
+	uint16_t txIrqs = IRQ_TX_DONE | IRQ_RX_TX_TIMEOUT;
+	uint16_t routed = DioIrqMasks[0] | DioIrqMasks[1] | DioIrqMasks[2];
+	uint16_t dioMasks[3] = { (uint16_t)( DioIrqMasks[0] | ( txIrqs & ~routed ) ), DioIrqMasks[1], DioIrqMasks[2] };
+	uint16_t irqMask = IrqMask | txIrqs;
+	bool routing = DioIrqRouting;
+
+	lg.unlock();
+
+	if (( routed & txIrqs ) != txIrqs) {
+		SetDioIrqParams( irqMask, dioMasks[0], dioMasks[1], dioMasks[2] );
+
+		lg.lock();
+		DioIrqRouting = routing;
+		lg.unlock();
+	}
+
+	TxQueueActive = true;
+}
+
+void SX128x::DisableTxQueue(void) {
+	TxQueueActive = false;
+}
+
+bool SX128x::QueuePacket(const uint8_t *payload, uint8_t size) {
+	std::shared_ptr<const ReedSolomon> fec = GetFec();
+	uint8_t parity = fec ? fec->GetParity() : 0;
+
+	if (!TxQueueActive || size + parity > TX_PACKET_MAX_SIZE) {
+		return false;
+	}
+
+	TxPacket_t *packet = TxRing.claim();
+
+	// The ring counts the overflow
+	if (packet == nullptr) {
+		return false;
+	}
+
+	packet->Size = size + parity;
+	memcpy(packet->Payload, payload, size);
+	if (parity) {
+		memset(packet->Payload + size, 0, parity);
+		fec->Encode(payload, size, packet->Payload + size);
+	}
+	TxRing.commit();
+
+	StartNextTx();
+	PreloadNextTx();
+
+	return true;
+}
+
+void SX128x::SetTxDoubleBuffer(bool enable) {
+	std::lock_guard<std::mutex> lg(TxQueueLock);
+
+	TxDoubleBuffer = enable;
+	TxPreloaded = false;
+}
+
+void SX128x::SetFec(uint8_t parity) {
+	if (parity > FEC_PARITY_MAX) {
+		throw std::invalid_argument("SX1280: too many FEC parity bytes");
+	}
+
+	if (parity == FecParity) {
+		return;
+	}
+
+	std::shared_ptr<const ReedSolomon> fec;
+
+	if (parity) {
+		fec = std::make_shared<const ReedSolomon>(parity);
+	}
+
+	{
+		std::lock_guard<std::mutex> lg(FecLock);
+
+		// The old code goes once the packets using it are done
+		Fec.swap(fec);
+		FecParity = parity;
+	}
+
+	// Sent again to turn the CRC off or back on
+	if (CurrentPacketParams.PacketType != PACKET_TYPE_NONE) {
+		SetPacketParams(CurrentPacketParams);
+	}
+}
+
+void SX128x::DisablePacketCrc(PacketParams_t& params) {
+	switch (params.PacketType) {
+		case PACKET_TYPE_GFSK:
+			params.Params.Gfsk.CrcLength = RADIO_CRC_OFF;
+			break;
+		case PACKET_TYPE_LORA:
+		case PACKET_TYPE_RANGING:
+			params.Params.LoRa.Crc = LORA_CRC_OFF;
+			break;
+		case PACKET_TYPE_FLRC:
+			params.Params.Flrc.CrcLength = RADIO_CRC_OFF;
+			break;
+		default:
+			break;
+	}
+}
+
+uint8_t SX128x::GetFecParity(void) {
+	return FecParity;
+}
+
+std::shared_ptr<const ReedSolomon> SX128x::GetFec(void) {
+	std::lock_guard<std::mutex> lg(FecLock);
+
+	return Fec;
+}
+
+void SX128x::SetTxSource(TxSource_t source) {
+	std::lock_guard<std::mutex> lg(TxQueueLock);
+
+	TxSource = std::move(source);
+}
+
+void SX128x::ResumeTxQueue(void) {
+	StartNextTx();
+}
+
+bool SX128x::StartNextTx(void) {
+	TxPacket_t *packet;
+	bool doubleBuffer, loaded, fromSource;
+	uint8_t base, size;
+
+	{
+		std::lock_guard<std::mutex> lg(TxQueueLock);
+
+		if (!TxQueueActive || TxInFlight) {
+			return false;
+		}
+
+		packet = TxRing.front();
+		doubleBuffer = TxDoubleBuffer;
+
+		if (packet != nullptr) {
+			loaded = TxPreloaded;
+			TxPreloaded = false;
+
+			// A packet that doesn't fit in a half takes the whole buffer
+			if (doubleBuffer) {
+				TxHalf = ( packet->Size > TX_HALF_BUFFER_SIZE ) ? 0 : TxHalf ^ TX_HALF_BUFFER_SIZE;
+			}
+			base = doubleBuffer ? TxHalf : TxBaseAddress.load();
+			size = packet->Size;
+		} else if (TxSource) {
+			// The source may take the whole buffer
+			if (doubleBuffer) {
+				TxHalf = 0;
+			}
+			base = doubleBuffer ? TxHalf : TxBaseAddress.load();
+			size = TxSource(base);
+			loaded = true;
+
+			if (size == 0) {
+				return false;
+			}
+		} else {
+			return false;
+		}
+
+		TxInFlight = true;
+		TxFromSource = fromSource = ( packet == nullptr );
+	}
+
+	try {
+		// The upload and SetTx go out in one bus transaction when the HAL
+		// allows it
+		BeginCommandBatch();
+		if (!loaded) {
+			SetPayload(packet->Payload, size, base);
+		}
+		SetTxPayloadLength(size);
+		if (doubleBuffer) {
+			SetBufferBaseAddresses(base, RxBaseAddress);
+		}
+		SetTx(RX_TX_SINGLE);
+		EndCommandBatch();
+	} catch (...) {
+		std::lock_guard<std::mutex> lg(TxQueueLock);
+		if (!fromSource) {
+			TxRing.pop();
+		}
+		TxInFlight = false;
+		TxFromSource = false;
+		throw;
+	}
+
+	if (doubleBuffer && !fromSource) {
+		PreloadNextTx();
+	}
+
+	return true;
+}
+
+void SX128x::SetTxPayloadLength(uint8_t size) {
+	PacketParams_t params = CurrentPacketParams;
+
+	// Only sent to the radio, CurrentPacketParams keeps the configured
+	// length for the next RX
+	if (SetPacketPayloadLength(params, size) && size != SentPayloadLength) {
+		WritePacketParams(params);
+	}
+}
+
+void SX128x::RestorePayloadLength(void) {
+	if (PayloadLengthCapsRx(CurrentPacketParams) && GetPacketPayloadLength(CurrentPacketParams) != SentPayloadLength) {
+		WritePacketParams(CurrentPacketParams);
+	}
+}
+
+uint8_t SX128x::GetPacketPayloadLength(const PacketParams_t& params) {
+	switch (params.PacketType) {
+		case PACKET_TYPE_GFSK:
+			return params.Params.Gfsk.PayloadLength;
+		case PACKET_TYPE_LORA:
+		case PACKET_TYPE_RANGING:
+			return params.Params.LoRa.PayloadLength;
+		case PACKET_TYPE_FLRC:
+			return params.Params.Flrc.PayloadLength;
+		default:
+			return 0;
+	}
+}
+
+bool SX128x::PayloadLengthCapsRx(const PacketParams_t& params) {
+	switch (params.PacketType) {
+		case PACKET_TYPE_GFSK:
+		case PACKET_TYPE_FLRC:
+			return true;
+		case PACKET_TYPE_LORA:
+		case PACKET_TYPE_RANGING:
+			// The explicit header carries the length
+			return params.Params.LoRa.HeaderType != LORA_PACKET_EXPLICIT;
+		default:
+			return false;
+	}
+}
+
+bool SX128x::SetPacketPayloadLength(PacketParams_t& params, uint8_t size) {
+	uint8_t *length;
+
+	switch (params.PacketType) {
+		case PACKET_TYPE_GFSK:
+			length = &params.Params.Gfsk.PayloadLength;
+			break;
+		case PACKET_TYPE_LORA:
+		case PACKET_TYPE_RANGING:
+			length = &params.Params.LoRa.PayloadLength;
+			break;
+		case PACKET_TYPE_FLRC:
+			length = &params.Params.Flrc.PayloadLength;
+			break;
+		default:
+			return false;
+	}
+
+	*length = size;
+
+	return true;
+}
+
+void SX128x::PreloadNextTx(void) {
+	// Held during the upload, so the packet can't start before it's complete
+	std::lock_guard<std::mutex> lg(TxQueueLock);
+
+	if (!TxDoubleBuffer || !TxInFlight || TxFromSource || TxPreloaded) {
+		return;
+	}
+
+	TxPacket_t *current = TxRing.front();
+	TxPacket_t *next = TxRing.at(1);
+
+	if (current == nullptr || next == nullptr || current->Size > TX_HALF_BUFFER_SIZE || next->Size > TX_HALF_BUFFER_SIZE) {
+		return;
+	}
+
+	SetPayload(next->Payload, next->Size, TxHalf ^ TX_HALF_BUFFER_SIZE);
+
+	TxPreloaded = true;
+	TxQueuePreloaded++;
+}
+
+bool SX128x::CompleteTx(bool timedOut) {
+	{
+		std::lock_guard<std::mutex> lg(TxQueueLock);
+
+		// Not a queued packet
+		if (!TxInFlight) {
+			return false;
+		}
+
+		// The packet stays in its slot until it's done, so a fast TX_DONE
+		// can't take it out again
+		if (!TxFromSource) {
+			TxRing.pop();
+		}
+		TxInFlight = false;
+		TxFromSource = false;
+	}
+
+	if (timedOut) {
+		TxQueueTimeouts++;
+	} else {
+		TxQueueSent++;
+	}
+
+	if (StartNextTx()) {
+		return true;
+	}
+
+	// The queue ran dry, the radio gets the configured length back
+	RestorePayloadLength();
+
+	return false;
+}
+
+SX128x::TxQueueStats_t SX128x::GetTxQueueStats(void) {
+	return { TxRing.capacity(), TxRing.size(), TxRing.high_water_mark(), TxQueueSent, TxQueueTimeouts, TxRing.drops(), TxQueuePreloaded };
+}
+
+uint64_t SX128x::SteadyClockNs(void) {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SX128x::SetOperatingMode(RadioOperatingModes_t mode) {
+	OperatingMode = mode;
+
+	if (!RxSessionActive) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lg(RxSessionLock);
+
+	if (!RxSessionActive) {
+		return;
+	}
+
+	uint64_t now = SteadyClockNs();
+
+	if (mode != MODE_RX && RxBlindSince == 0) {
+		RxBlindSince = now;
+		RxBlindWindows++;
+	} else if (mode == MODE_RX && RxBlindSince != 0) {
+		uint64_t blind = now - RxBlindSince;
+
+		RxBlindTime += blind;
+		RxLongestBlindWindow = std::max(RxLongestBlindWindow, blind);
+		RxBlindSince = 0;
+	}
+}
+
+void SX128x::StartContinuousRx(void) {
+	RxSessionActive = false;
+
+	SetRx( RX_TX_CONTINUOUS );
+
+	std::lock_guard<std::mutex> lg(RxSessionLock);
+
+	RxSessionStart = SteadyClockNs();
+	RxSessionEnd = 0;
+	RxBlindSince = 0;
+	RxBlindTime = 0;
+	RxBlindWindows = 0;
+	RxLongestBlindWindow = 0;
+	RxSessionPackets = 0;
+	RxBufferGaps = 0;
+	RxBufferPointer = RxBaseAddress;
+	RxNextBufferPointer = RxBaseAddress;
+	RxSessionActive = true;
+}
+
+void SX128x::StopContinuousRx(void) {
+	{
+		std::lock_guard<std::mutex> lg(RxSessionLock);
+
+		RxSessionActive = false;
+		RxSessionEnd = SteadyClockNs();
+
+		// Close the blind window in progress
+		if (RxBlindSince != 0) {
+			uint64_t blind = RxSessionEnd - RxBlindSince;
+
+			RxBlindTime += blind;
+			RxLongestBlindWindow = std::max(RxLongestBlindWindow, blind);
+			RxBlindSince = 0;
+		}
+	}
+
+	SetStandby( STDBY_RC );
+}
+
+void SX128x::ResumeContinuousRx(void) {
+	if (RxSessionActive && OperatingMode != MODE_RX) {
+		SetRx( RX_TX_CONTINUOUS );
+	}
+}
+
+void SX128x::TrackRxBuffer(void) {
+	uint8_t size, offset;
+
+	// Served from the status prefetched with the IRQs
+	GetRxBufferStatus(&size, &offset);
+
+	std::lock_guard<std::mutex> lg(RxSessionLock);
+
+	// The radio writes each packet right after the previous one, a packet
+	// starting elsewhere means an RX_DONE was missed
+	if (RxSessionPackets > 0 && offset != RxNextBufferPointer) {
+		RxBufferGaps++;
+	}
+
+	RxSessionPackets++;
+	RxBufferPointer = offset;
+	RxNextBufferPointer = offset + size;
+}
+
+SX128x::RxSessionStats_t SX128x::GetRxSessionStats(void) {
+	std::lock_guard<std::mutex> lg(RxSessionLock);
+
+	uint64_t end = RxSessionActive ? SteadyClockNs() : RxSessionEnd;
+	uint64_t blind = RxBlindTime;
+
+	// Include the blind window in progress
+	if (RxSessionActive && RxBlindSince != 0) {
+		blind += end - RxBlindSince;
+	}
+
+	return { RxSessionActive, RxSessionStart ? end - RxSessionStart : 0, blind, RxBlindWindows, RxLongestBlindWindow, RxSessionPackets, RxBufferGaps, RxBufferPointer };
+}
+
+void SX128x::ArmTurnaround(const uint8_t *response, uint8_t size, uint16_t delayUs, TickTime_t rxTimeout) {
+	std::shared_ptr<const ReedSolomon> fec = GetFec();
+	uint8_t parity = fec ? fec->GetParity() : 0;
+	uint8_t length = size + parity;
+
+	// The RX and the response after it share the packet parameters, where
+	// their length caps the received packets the response is padded to it
+	if (PayloadLengthCapsRx(CurrentPacketParams)) {
+		if (length > GetPacketPayloadLength(CurrentPacketParams)) {
+			throw std::invalid_argument("SX1280: turnaround response longer than the payload length");
+		}
+		length = GetPacketPayloadLength(CurrentPacketParams);
+	}
+
+	if (size == 0 || length > TX_HALF_BUFFER_SIZE) {
+		throw std::invalid_argument("SX1280: bad turnaround response size");
+	}
+
+	if (delayUs <= AUTO_TX_OFFSET) {
+		throw std::invalid_argument("SX1280: turnaround delay too short");
+	}
+
+	std::lock_guard<std::mutex> lg(TurnaroundLock);
+
+	if (!TurnaroundArmed) {
+		TurnaroundSavedTxBase = TxBaseAddress;
+		TurnaroundSavedRxBase = RxBaseAddress;
+		TurnaroundCount = 0;
+		TurnaroundCorrupted = 0;
+	}
+
+	memcpy(TurnaroundPayload, response, size);
+	memset(TurnaroundPayload + size, 0, length - size);
+	if (parity) {
+		fec->Encode(TurnaroundPayload, length - parity, TurnaroundPayload + length - parity);
+	}
+	TurnaroundSize = length;
+	TurnaroundDelayUs = delayUs;
+	TurnaroundRxTimeout = rxTimeout;
+
+	BeginCommandBatch();
+	SetAutoFs( true );
+	SetBufferBaseAddresses( ( uint8_t )( 0x100 - length ), 0x00 );
+	LoadTurnaround();
+	EndCommandBatch();
+
+	TurnaroundArmed = true;
+}
+
+void SX128x::DisarmTurnaround(void) {
+	std::lock_guard<std::mutex> lg(TurnaroundLock);
+
+	if (!TurnaroundArmed) {
+		return;
+	}
+
+	TurnaroundArmed = false;
+
+	BeginCommandBatch();
+	StopAutoTx();
+	SetAutoFs( false );
+	SetBufferBaseAddresses( TurnaroundSavedTxBase, TurnaroundSavedRxBase );
+	SetStandby( STDBY_RC );
+	EndCommandBatch();
+}
+
+void SX128x::LoadTurnaround(void) {
+	// Upload, AutoTx and SetRx go out in one bus transaction when the HAL
+	// allows it
+	BeginCommandBatch();
+	SetPayload( TurnaroundPayload, TurnaroundSize, TxBaseAddress );
+	SetTxPayloadLength( TurnaroundSize );
+	SetAutoTx( TurnaroundDelayUs );
+	SetRx( TurnaroundRxTimeout );
+	EndCommandBatch();
+}
+
+void SX128x::StartTurnaroundTx(void) {
+	uint8_t size, offset;
+
+	HalPostRx();
+	HalPreTx();
+	SetOperatingMode( MODE_TX );
+
+	// Served from the status prefetched with the IRQs. With an explicit LoRa
+	// header nothing caps the request, one running into the response at the
+	// end of the buffer has overwritten it and the radio sends it anyway.
+	GetRxBufferStatus(&size, &offset);
+
+	if (offset + size > 0x100 - TurnaroundSize) {
+		TurnaroundCorrupted++;
+	}
+}
+
+bool SX128x::RearmTurnaround(void) {
+	if (!TurnaroundArmed) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lg(TurnaroundLock);
+
+	// Disarmed meanwhile
+	if (!TurnaroundArmed) {
+		return false;
+	}
+
+	TurnaroundCount++;
+	LoadTurnaround();
+
+	return true;
+}
+
+uint64_t SX128x::GetTurnaroundCount(void) {
+	return TurnaroundCount;
+}
+
+uint64_t SX128x::GetTurnaroundCorrupted(void) {
+	return TurnaroundCorrupted;
+}
+
+void SX128x::WaitOnBusy() {
+	if (HalWaitOnBusy(BUSY_EVENT_TIMEOUT_US)) {
+		return;
+	}
+
+	// Most commands release BUSY within a few microseconds, so spin first
+	// and only fall back to sleeping for the slow ones
+	auto spin_end = std::chrono::steady_clock::now() + std::chrono::microseconds(BUSY_SPIN_TIME_US);
+
+	while (HalGpioRead(GPIO_PIN_BUSY)) {
+		if (std::chrono::steady_clock::now() < spin_end) {
+			std::this_thread::yield();
+		} else {
+			std::this_thread::sleep_for(std::chrono::microseconds(10));
+		}
+	}
+}
+
+void SX128x::PrepareCommand(void) {
+	WaitOnBusy();
+	BusyPending = false;
+}
+
+void SX128x::CompleteCommand(void) {
+	if (DeferredBusyCheck) {
+		BusyPending = true;
+	} else {
+		WaitOnBusy();
+	}
+}
+
+void SX128x::SetDeferredBusyCheck(bool enable) {
+	std::lock_guard<std::mutex> lg(IOLock);
+
+	DeferredBusyCheck = enable;
+}
+
+void SX128x::WaitOnCommandDone(void) {
+	std::lock_guard<std::mutex> lg(IOLock);
+
+	FlushCommandBatch();
+
+	if (BusyPending) {
+		PrepareCommand();
+	}
+}
+
+void SX128x::WaitOnBusyLong() {
+	if (HalWaitOnBusy(BUSY_EVENT_LONG_TIMEOUT_US)) {
+		return;
+	}
+
+	while (HalGpioRead(GPIO_PIN_BUSY)) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+void SX128x::Reset(void) {
+	std::lock_guard<std::mutex> lg(IOLock);
+
+	HalGpioWrite(GPIO_PIN_RESET, 0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	HalGpioWrite(GPIO_PIN_RESET, 1);
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+}
+
+void SX128x::Wakeup(void) {
+	std::lock_guard<std::mutex> lg(IOLock);
+
+	if (SX1280_DEBUG) {
+		printf("SX1280: Wakeup\n");
+	}
+
+	FlushCommandBatch();
+
+	uint8_t buf[2] = {RADIO_GET_STATUS, 0};
+
+	HalSpiWrite(buf, 2);
+
+	// Wait for chip to be ready.
+	WaitOnBusyLong();
+	BusyPending = false;
+
+	if (SX1280_DEBUG) {
+		printf("SX1280: Wakeup done\n");
+	}
+}
+
+void SX128x::WriteCommand(SX128x::RadioCommands_t opcode, uint8_t *buffer, uint16_t size) {
+	std::lock_guard<std::mutex> lg(IOLock);
+
+	if (SX1280_DEBUG) {
+		printf("SX1280: WriteCommand: 0x%02x %u\n", opcode, size);
+	}
+
+	uint8_t header = opcode;
+
+	// SetSleep doesn't release BUSY, so it can't be followed by other commands
+	if (opcode != RADIO_SET_SLEEP && BatchCommand(&header, 1, buffer, size)) {
+		return;
+	}
+
+	FlushCommandBatch();
+
+	if (size >= SPI_SCRATCH_SIZE) {
+		throw std::length_error("SX1280: command too long");
+	}
+
+	SpiTx[0] = opcode;
+	if (size) {
+		memcpy(SpiTx+1, buffer, size);
+	}
+
+	PrepareCommand();
+
+	HalSpiWrite(SpiTx, size+1);
+
+	if (SX1280_DEBUG) {
+		printf("SX1280: WriteCommand: send done\n");
+	}
+
+	if (opcode != RADIO_SET_SLEEP) {
+		CompleteCommand();
+		if (SX1280_DEBUG) {
+			printf("SX1280: WriteCommand: wait done\n");
+		}
+	}
+}
+
+void SX128x::ReadCommand(SX128x::RadioCommands_t opcode, uint8_t *buffer, uint16_t size) {
+	std::lock_guard<std::mutex> lg(IOLock);
+
+	if (IrqCacheValid && IrqCacheOwner == std::this_thread::get_id()) {
+		if (opcode == RADIO_GET_RXBUFFERSTATUS && size <= sizeof(IrqCacheRxBufferStatus)) {
+			memcpy(buffer, IrqCacheRxBufferStatus, size);
+			return;
+		}
+
+		if (opcode == RADIO_GET_PACKETSTATUS && size <= sizeof(IrqCachePacketStatus)) {
+			memcpy(buffer, IrqCachePacketStatus, size);
+			return;
+		}
+	}
+
+	FlushCommandBatch();
+
+	PrepareCommand();
+
+	if (opcode == RADIO_GET_STATUS) {
+		SetReadHeader(opcode, 0, 0, 0);
+
+		HalSpiTransfer(SpiRx, SpiTxNop, 3);
+		buffer[0] = SpiRx[0];
+	} else {
+		if (size > SPI_SCRATCH_SIZE-2) {
+			throw std::length_error("SX1280: command too long");
+		}
+
+		SetReadHeader(opcode, 0, 0, 0);
+
+		HalSpiTransfer(SpiRx, SpiTxNop, size+2);
+		memcpy(buffer, SpiRx+2, size);
+	}
+
+	CompleteCommand();
+}
+
+void SX128x::WriteRegister(uint16_t address, uint8_t *buffer, uint16_t size) {
+	std::lock_guard<std::mutex> lg(IOLock);
+
+	if (SX1280_DEBUG) {
+		printf("SX1280: WriteRegister: 0x%04x %u\n", address, size);
+	}
+
+	uint8_t header[3] = {RADIO_WRITE_REGISTER, static_cast<uint8_t>((address & 0xFF00) >> 8), static_cast<uint8_t>(address & 0x00FF)};
+
+	if (BatchCommand(header, 3, buffer, size)) {
+		return;
+	}
+
+	FlushCommandBatch();
+
+	// Long writes are split in chunks fitting the scratch buffer
+	do {
+		uint16_t chunk_size = std::min<uint16_t>(size, SPI_SCRATCH_SIZE-3);
+
+		SpiTx[0] = RADIO_WRITE_REGISTER;
+		SpiTx[1] = ((address & 0xFF00) >> 8);
+		SpiTx[2] = (address & 0x00FF);
+		memcpy(SpiTx+3, buffer, chunk_size);
+
+		PrepareCommand();
+
+		HalSpiWrite(SpiTx, chunk_size+3);
+
+		address += chunk_size;
+		buffer += chunk_size;
+		size -= chunk_size;
+	} while (size > 0);
+
+	if (SX1280_DEBUG) {
+		printf("SX1280: WriteRegister: send done\n");
+	}
+
+	CompleteCommand();
+
+	if (SX1280_DEBUG) {
+		printf("SX1280: WriteRegister: Wait done\n");
 	}
 }
 
@@ -1573,22 +2757,25 @@ void SX128x::WriteRegister(uint16_t address, uint8_t value) {
 void SX128x::ReadRegister(uint16_t address, uint8_t *buffer, uint16_t size) {
 	std::lock_guard<std::mutex> lg(IOLock);
 
-	WaitOnBusy();
+	FlushCommandBatch();
 
-	auto total_transfer_size = 4+size;
-	auto *buf_out = (uint8_t *)alloca(total_transfer_size);
-	auto *buf_in = (uint8_t *)alloca(total_transfer_size);
+	// Long reads are split in chunks fitting the scratch buffer
+	do {
+		uint16_t chunk_size = std::min<uint16_t>(size, SPI_SCRATCH_SIZE-4);
 
-	memset(buf_out, 0, total_transfer_size);
-	buf_out[0] = RADIO_READ_REGISTER;
-	buf_out[1] = ((address & 0xFF00) >> 8);
-	buf_out[2] = (address & 0x00FF);
+		SetReadHeader(RADIO_READ_REGISTER, ((address & 0xFF00) >> 8), (address & 0x00FF), 0);
 
-	HalSpiTransfer(buf_in, buf_out, total_transfer_size);
+		PrepareCommand();
 
-	memcpy(buffer, buf_in+4, size);
+		HalSpiTransfer(SpiRx, SpiTxNop, chunk_size+4);
+		memcpy(buffer, SpiRx+4, chunk_size);
 
-	WaitOnBusy();
+		address += chunk_size;
+		buffer += chunk_size;
+		size -= chunk_size;
+	} while (size > 0);
+
+	CompleteCommand();
 }
 
 uint8_t SX128x::ReadRegister(uint16_t address) {
@@ -1598,42 +2785,44 @@ uint8_t SX128x::ReadRegister(uint16_t address) {
 	return data;
 }
 
-void SX128x::WriteBuffer(uint8_t offset, uint8_t *buffer, uint8_t size) {
+void SX128x::WriteBuffer(uint8_t offset, const uint8_t *buffer, uint8_t size) {
 	std::lock_guard<std::mutex> lg(IOLock);
 
-	WaitOnBusy();
+	uint8_t header[2] = {RADIO_WRITE_BUFFER, offset};
 
-	auto total_transfer_size = 2+size;
-	auto *buf_out = (uint8_t *)alloca(total_transfer_size);
+	if (BatchCommand(header, 2, buffer, size)) {
+		return;
+	}
 
-	buf_out[0] = RADIO_WRITE_BUFFER;
-	buf_out[1] = offset;
+	FlushCommandBatch();
 
-	memcpy(buf_out+2, buffer, size);
+	PrepareCommand();
 
-	HalSpiWrite(buf_out, total_transfer_size);
+	HalSpiTransferChained(header, 2, nullptr, buffer, size);
 
-	WaitOnBusy();
+	CompleteCommand();
 }
 
 void SX128x::ReadBuffer(uint8_t offset, uint8_t *buffer, uint8_t size) {
 	std::lock_guard<std::mutex> lg(IOLock);
 
-	WaitOnBusy();
+	FlushCommandBatch();
 
-	auto total_transfer_size = 3+size;
-	auto *buf_out = (uint8_t *)alloca(total_transfer_size);
-	auto *buf_in = (uint8_t *)alloca(total_transfer_size);
+	PrepareCommand();
 
-	memset(buf_out, 0, total_transfer_size);
+	uint8_t header[3] = {RADIO_READ_BUFFER, offset, 0};
 
-	buf_out[0] = RADIO_READ_BUFFER;
-	buf_out[1] = offset;
+	HalSpiTransferChained(header, 3, buffer, nullptr, size);
 
-	HalSpiTransfer(buf_in, buf_out, total_transfer_size);
-
-	memcpy(buffer, buf_in+3, size);
+	CompleteCommand();
+}
 
-	WaitOnBusy();
+void SX128x::SetReadHeader(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3) {
+	// Always rewrite the 4 header bytes so SpiTxNop stays all NOPs past the
+	// header of the current read
+	SpiTxNop[0] = b0;
+	SpiTxNop[1] = b1;
+	SpiTxNop[2] = b2;
+	SpiTxNop[3] = b3;
 }
 
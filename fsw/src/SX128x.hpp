@@ -27,7 +27,11 @@
 #include <memory>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <algorithm>
+#include <stdexcept>
 
 #include <cmath>
 #include <cstdio>
@@ -35,6 +39,8 @@
 #include <cstring>
 #include <cinttypes>
 
+#include "SpscRing.hpp"
+#include "ReedSolomon.hpp"
 
 /*!
  * \brief Represents the SX128x and its features
@@ -54,6 +60,79 @@ public:
 		 */
 		AUTO_TX_OFFSET = 33,
 
+		/*!
+		 * \brief Maximum number of commands held in a command batch
+		 */
+		BATCH_MAX_COMMANDS = 16,
+
+		/*!
+		 * \brief Size in bytes of the command batch buffer
+		 */
+		BATCH_BUFFER_SIZE = 256,
+
+		/*!
+		 * \brief Size in bytes of the SPI scratch buffers, fits a 255 bytes
+		 *        data buffer access and its header
+		 */
+		SPI_SCRATCH_SIZE = 260,
+
+		/*!
+		 * \brief Alignment of the SPI scratch buffers
+		 */
+		CACHE_LINE_SIZE = 64,
+
+		/*!
+		 * \brief Time during which BUSY is polled back to back before the
+		 *        driver starts sleeping between polls, in microseconds
+		 */
+		BUSY_SPIN_TIME_US = 50,
+
+		/*!
+		 * \brief Timeout of a BUSY falling edge wait, in microseconds
+		 */
+		BUSY_EVENT_TIMEOUT_US = 10000,
+
+		/*!
+		 * \brief Timeout of a BUSY falling edge wait after a wakeup, in microseconds
+		 */
+		BUSY_EVENT_LONG_TIMEOUT_US = 100000,
+
+		/*!
+		 * \brief Default number of IRQ events queued for the callback dispatcher
+		 */
+		DISPATCH_QUEUE_SIZE = 32,
+
+		/*!
+		 * \brief Default number of packet slots of the RX packet ring
+		 */
+		RX_RING_SIZE = 16,
+
+		/*!
+		 * \brief Size in bytes of the largest packet the radio receives
+		 */
+		RX_PACKET_MAX_SIZE = 255,
+
+		/*!
+		 * \brief Default number of packet slots of the TX queue
+		 */
+		TX_QUEUE_SIZE = 16,
+
+		/*!
+		 * \brief Size in bytes of the largest packet the radio sends
+		 */
+		TX_PACKET_MAX_SIZE = 255,
+
+		/*!
+		 * \brief Size in bytes of each half of the data buffer in TX double
+		 *        buffering
+		 */
+		TX_HALF_BUFFER_SIZE = 128,
+
+		/*!
+		 * \brief Most Reed-Solomon parity bytes per packet
+		 */
+		FEC_PARITY_MAX = 64,
+
 		/*!
 		 * \brief The address of the register holding the firmware version MSB
 		 */
@@ -1034,6 +1113,57 @@ const RadioRegisters_t RadioRegsInit[1] = {0,0}; //cfs
 		std::function<void(bool cadFlag)> cadDone;              //!< Pointer to a function run on channel activity detected
 	} RadioCallbacks_t;
 
+	/*!
+	 * \brief Where PollIrqs looks for pending IRQs
+	 */
+	typedef enum {
+		IRQ_POLL_STATUS,                        //!< Read the IRQ status over SPI
+		IRQ_POLL_DIO,                           //!< Read the DIO levels with GetDioStatus
+	} IrqPollSource_t;
+
+	/*!
+	 * \brief Actions taken on IRQs, see IrqRule_t
+	 */
+	typedef enum : uint8_t {
+		IRQ_ACTION_TX_DONE,                     //!< HalPostTx then txDone
+		IRQ_ACTION_TX_TIMEOUT,                  //!< HalPostTx then txTimeout
+		IRQ_ACTION_RX_DONE,                     //!< rxDone
+		IRQ_ACTION_RX_TIMEOUT,                  //!< HalPostRx then rxTimeout
+		IRQ_ACTION_RX_SYNCWORD_DONE,            //!< rxSyncWordDone
+		IRQ_ACTION_RX_HEADER_DONE,              //!< rxHeaderDone
+		IRQ_ACTION_RX_ERROR_CRC,                //!< rxError( IRQ_CRC_ERROR_CODE )
+		IRQ_ACTION_RX_ERROR_SYNCWORD,           //!< rxError( IRQ_SYNCWORD_ERROR_CODE )
+		IRQ_ACTION_RX_ERROR_HEADER,             //!< rxError( IRQ_HEADER_ERROR_CODE )
+		IRQ_ACTION_RX_ERROR_RANGING_ON_LORA,    //!< rxError( IRQ_RANGING_ON_LORA_ERROR_CODE )
+		IRQ_ACTION_CAD_DETECTED,                //!< cadDone( true )
+		IRQ_ACTION_CAD_CLEAR,                   //!< cadDone( false )
+		IRQ_ACTION_RANGING_SLAVE_ERROR,         //!< rangingDone( IRQ_RANGING_SLAVE_ERROR_CODE )
+		IRQ_ACTION_RANGING_SLAVE_VALID,         //!< rangingDone( IRQ_RANGING_SLAVE_VALID_CODE )
+		IRQ_ACTION_RANGING_MASTER_ERROR,        //!< HalPostTx then rangingDone( IRQ_RANGING_MASTER_ERROR_CODE )
+		IRQ_ACTION_RANGING_MASTER_VALID,        //!< HalPostTx then rangingDone( IRQ_RANGING_MASTER_VALID_CODE )
+	} IrqAction_t;
+
+	/*!
+	 * \brief Runs Action when all the Trigger IRQs are set and none of the
+	 *        Unless IRQs are
+	 */
+	typedef struct {
+		uint16_t Trigger;
+		uint16_t Unless;
+		IrqAction_t Action;
+	} IrqRule_t;
+
+	/*!
+	 * \brief IRQ dispatch rules of one packet type and operating mode
+	 *
+	 * Rules run in order. Mask holds every IRQ the rules look at.
+	 */
+	typedef struct {
+		uint16_t Mask;
+		uint8_t Count;
+		IrqRule_t Rules[8];
+	} IrqDispatchEntry_t;
+
 	/*!
 	 * \brief Structure describing the GPIO pin functions
 	 */
@@ -1047,14 +1177,71 @@ const RadioRegisters_t RadioRegsInit[1] = {0,0}; //cfs
 
 	virtual uint8_t HalGpioRead(GpioPinFunction_t func) = 0;
 
+	/*!
+	 * \brief Blocks until the BUSY pin is low, waiting for its falling edge
+	 *
+	 * \param [in]  timeout_us    Maximum time to wait [us]
+	 *
+	 * \retval      low           true if BUSY is low. false on timeout or when
+	 *                            the HAL can't wait for edges, the driver then
+	 *                            polls the pin with HalGpioRead.
+	 */
+	virtual bool HalWaitOnBusy([[maybe_unused]] uint32_t timeout_us) {
+		return false;
+	}
+
 	virtual void HalGpioWrite(GpioPinFunction_t func, uint8_t value) = 0;
 
+	/*!
+	 * \brief Full duplex SPI transfer of size bytes in one chip select window
+	 *
+	 * \param [out] buffer_in     Received bytes, nullptr to discard them
+	 * \param [in]  buffer_out    Bytes to send, nullptr to send zeros (NOP)
+	 * \param [in]  size          Transfer size
+	 */
 	virtual void HalSpiTransfer(uint8_t *buffer_in, const uint8_t *buffer_out, uint16_t size) = 0;
 
 	void HalSpiRead(uint8_t *buffer_in, uint16_t size);
 
 	void HalSpiWrite(const uint8_t *buffer_out, uint16_t size);
 
+	/*!
+	 * \brief Transfers a batch of complete commands
+	 *
+	 * The commands are stored back to back in buffer_out and each one must be
+	 * sent in its own chip select window. The default implementation issues
+	 * one HalSpiTransfer per command and waits on BUSY in between. A HAL able
+	 * to chain several chip select windows in one bus transaction should
+	 * override it. Such a HAL must still wait on BUSY after the commands
+	 * that keep it high longer than the gap between two chip select windows:
+	 * SetBufferBaseAddresses, SetAutoFs and SetAutoTx/StopAutoTx.
+	 *
+	 * \param [out] buffer_in     Received bytes, same layout as buffer_out,
+	 *                            nullptr to discard them
+	 * \param [in]  buffer_out    Commands to send
+	 * \param [in]  sizes         Size of each command
+	 * \param [in]  count         Number of commands
+	 */
+	virtual void HalSpiTransferBatch(uint8_t *buffer_in, const uint8_t *buffer_out, const uint16_t *sizes, uint16_t count);
+
+	/*!
+	 * \brief Sends a command header followed by a data segment in one chip
+	 *        select window
+	 *
+	 * The header response is discarded. The data segment is either sent from
+	 * data_out or received into data_in. The default implementation gathers
+	 * both segments in the scratch buffers, a HAL able to chain transfers
+	 * with the chip select held low should override it so the caller's data
+	 * buffer is used in place.
+	 *
+	 * \param [in]  header        Command header (at most 4 bytes)
+	 * \param [in]  header_size   Command header size
+	 * \param [out] data_in       Received data, nullptr for a write
+	 * \param [in]  data_out      Data to send, nullptr for a read
+	 * \param [in]  data_size     Data segment size
+	 */
+	virtual void HalSpiTransferChained(const uint8_t *header, uint16_t header_size, uint8_t *data_in, const uint8_t *data_out, uint16_t data_size);
+
 	virtual void HalPreTx() {
 
 	}
@@ -1071,6 +1258,109 @@ const RadioRegisters_t RadioRegsInit[1] = {0,0}; //cfs
 
 	}
 
+	/*!
+	 * \brief Time of the IRQ being handled
+	 *
+	 * The default implementation returns the current steady clock time. A HAL
+	 * that timestamps its DIO edges should return the edge time instead.
+	 *
+	 * \retval      timestamp     Time in nanoseconds
+	 */
+	virtual uint64_t HalGetIrqTimestamp();
+
+	/*!
+	 * \brief IRQ event as captured on the IRQ thread
+	 *
+	 * Holds everything the callbacks need, so they can run later on the
+	 * dispatcher thread after the radio state has moved on.
+	 */
+	typedef struct {
+		uint64_t Timestamp;
+		uint16_t IrqRegs;
+		RadioPacketTypes_t PacketType;
+		RadioOperatingModes_t OperatingMode;
+		bool HasRxStatus;
+		uint8_t RxBufferStatus[2];
+		uint8_t PacketStatus[5];
+	} IrqEvent_t;
+
+	/*!
+	 * \brief Counters of the callback dispatcher queue
+	 */
+	typedef struct {
+		size_t QueueSize;
+		size_t Pending;
+		size_t HighWaterMark;
+		uint64_t Drops;
+	} DispatcherStats_t;
+
+	/*!
+	 * \brief Packet stored by the RX packet ring
+	 */
+	typedef struct {
+		uint64_t Timestamp;                     //!< Time of the RX_DONE IRQ, see HalGetIrqTimestamp
+		RadioPacketTypes_t PacketType;
+		int8_t Rssi;                            //!< RSSI of the packet (LoRa, ranging) or of the sync word [dBm]
+		int8_t Snr;                             //!< SNR of the packet, LoRa and ranging only [dB]
+		int32_t FrequencyError;                 //!< Estimated frequency error, LoRa and ranging only [Hz]
+		uint8_t Size;
+		uint8_t Payload[RX_PACKET_MAX_SIZE];
+	} RxPacket_t;
+
+	/*!
+	 * \brief Counters of the RX packet ring
+	 */
+	typedef struct {
+		size_t Slots;
+		size_t Pending;
+		size_t HighWaterMark;
+		uint64_t Received;                      //!< Packets stored in the ring
+		uint64_t Overflows;                     //!< Packets dropped because the ring was full
+		uint64_t FecCorrected;                  //!< Bytes corrected by the FEC
+		uint64_t FecFailures;                   //!< Packets dropped because the FEC couldn't correct them
+	} RxRingStats_t;
+
+	/*!
+	 * \brief Packet waiting in the TX queue
+	 */
+	typedef struct {
+		uint8_t Size;
+		uint8_t Payload[TX_PACKET_MAX_SIZE];
+	} TxPacket_t;
+
+	/*!
+	 * \brief Counters of the TX queue
+	 */
+	typedef struct {
+		size_t Slots;
+		size_t Pending;
+		size_t HighWaterMark;
+		uint64_t Sent;                          //!< Packets whose transmission completed
+		uint64_t Timeouts;                      //!< Packets whose transmission timed out
+		uint64_t Overflows;                     //!< Packets refused because the queue was full
+		uint64_t Preloaded;                     //!< Packets uploaded while the previous one was on air
+	} TxQueueStats_t;
+
+	/*!
+	 * \brief Writes the next packet straight into the data buffer at offset,
+	 *        returns its size or 0 if there is nothing to send
+	 */
+	typedef std::function<uint8_t(uint8_t offset)> TxSource_t;
+
+	/*!
+	 * \brief Counters of a continuous RX session, times in nanoseconds
+	 */
+	typedef struct {
+		bool Active;
+		uint64_t SessionTime;                   //!< Time since StartContinuousRx, up to StopContinuousRx
+		uint64_t BlindTime;                     //!< Part of SessionTime the radio wasn't in RX
+		uint64_t BlindWindows;                  //!< Times the radio left RX
+		uint64_t LongestBlindWindow;
+		uint64_t Packets;                       //!< RX_DONE IRQs handled
+		uint64_t BufferGaps;                    //!< Packets not starting where the previous one ended
+		uint8_t BufferPointer;                  //!< Start of the last packet in the data buffer
+	} RxSessionStats_t;
+
 	struct {
 		/*!
 		* \brief Callback on Tx done interrupt
@@ -1153,7 +1443,7 @@ private:
 	/*!
 	 * \brief Holds a flag raised on radio interrupt
 	 */
-//	bool IrqState = false;
+	std::atomic<bool> IrqState{false};
 
 	/*!
 	 * \brief Hardware DIO IRQ functions
@@ -1163,13 +1453,375 @@ private:
 	/*!
 	 * \brief Holds the polling state of the driver
 	 */
-//	bool PollingMode = false;
+	std::atomic<bool> PollingMode{false};
+
+	/*!
+	 * \brief Raised by StopIrqPolling, cleared when RunIrqPolling returns
+	 */
+	std::atomic<bool> PollingStop{false};
 
 
 	ModulationParams_t CurrentModParams = {};
 
 	PacketParams_t CurrentPacketParams = {};
 
+	/*!
+	 * \brief Payload length last sent to the radio, the one of the packet on
+	 *        air while CurrentPacketParams keeps the configured one
+	 */
+	uint8_t SentPayloadLength = 0;
+
+	/*!
+	 * \brief Command batch state, protected by IOLock
+	 */
+	std::thread::id BatchOwner;
+	uint16_t BatchDepth = 0;
+	uint16_t BatchCount = 0;
+	uint16_t BatchLength = 0;
+	uint16_t BatchSizes[BATCH_MAX_COMMANDS];
+	uint8_t BatchTx[BATCH_BUFFER_SIZE];
+
+	/*!
+	 * \brief SPI scratch buffers, protected by IOLock
+	 *
+	 * SpiTx holds outgoing commands, SpiRx receives read responses. SpiTxNop
+	 * is only written in its first 4 bytes (the read header) and is zero past
+	 * them, so reads never have to clear their dummy bytes.
+	 */
+	alignas(CACHE_LINE_SIZE) uint8_t SpiTx[SPI_SCRATCH_SIZE];
+	alignas(CACHE_LINE_SIZE) uint8_t SpiRx[SPI_SCRATCH_SIZE];
+	alignas(CACHE_LINE_SIZE) uint8_t SpiTxNop[SPI_SCRATCH_SIZE] = {};
+
+	/*!
+	 * \brief Deferred BUSY check state, protected by IOLock
+	 */
+	bool DeferredBusyCheck = false;
+	bool BusyPending = false;
+
+	/*!
+	 * \brief RX status prefetched by ProcessIrqs, protected by IOLock
+	 *
+	 * Only served to the thread running the callbacks, until ProcessIrqs
+	 * returns.
+	 */
+	std::thread::id IrqCacheOwner;
+	bool IrqCacheValid = false;
+	uint8_t IrqCacheRxBufferStatus[2];
+	uint8_t IrqCachePacketStatus[5];
+
+	/*!
+	 * \brief Callback dispatcher state
+	 *
+	 * The IRQ side pushes events with IOLock2 held, DispatcherActive is only
+	 * changed with IOLock2 held too. DispatcherStop is protected by
+	 * DispatcherLock.
+	 */
+	SpscRing<IrqEvent_t> IrqQueue;
+	bool DispatcherActive = false;
+	bool DispatcherStop = false;
+	std::mutex DispatcherLock;
+	std::condition_variable DispatcherCond;
+
+	/*!
+	 * \brief Timestamp of the IRQ event whose callbacks are running
+	 */
+	uint64_t DispatchTimestamp = 0;
+
+	/*!
+	 * \brief RX packet ring state
+	 *
+	 * The thread running the callbacks fills the slots, RxRingLock only
+	 * orders a commit before the empty check of a blocked ReceivePacket.
+	 */
+	SpscRing<RxPacket_t> RxRing;
+	std::atomic<bool> RxRingActive{false};
+	std::atomic<uint64_t> RxRingReceived{0};
+	std::mutex RxRingLock;
+	std::condition_variable RxRingCond;
+
+	/*!
+	 * \brief TX queue state
+	 *
+	 * The sending thread fills the slots. The packet on air keeps its slot
+	 * until CompleteTx. TxInFlight and the consumer side of TxRing are
+	 * protected by TxQueueLock, as both the sending thread and the thread
+	 * running the callbacks start packets.
+	 */
+	SpscRing<TxPacket_t> TxRing;
+	std::atomic<bool> TxQueueActive{false};
+	bool TxInFlight = false;
+	std::mutex TxQueueLock;
+	bool TxDoubleBuffer = false;
+	bool TxPreloaded = false;
+	uint8_t TxHalf = 0;
+	std::atomic<uint64_t> TxQueueSent{0};
+	std::atomic<uint64_t> TxQueueTimeouts{0};
+	std::atomic<uint64_t> TxQueuePreloaded{0};
+
+	/*!
+	 * \brief Packets written by the TX source once the TX queue is empty,
+	 *        TxFromSource tells CompleteTx the packet on air has no slot.
+	 *        Protected by TxQueueLock.
+	 */
+	TxSource_t TxSource;
+	bool TxFromSource = false;
+
+	/*!
+	 * \brief Reed-Solomon code of the packets, FecParity is 0 when it's off.
+	 *        Fec is swapped under FecLock, the TX and RX paths hold a
+	 *        reference while they use it, so a SetFec can't free it under
+	 *        them.
+	 */
+	std::mutex FecLock;
+	std::shared_ptr<const ReedSolomon> Fec;
+	std::atomic<uint8_t> FecParity{0};
+	std::atomic<uint64_t> RxFecCorrected{0};
+	std::atomic<uint64_t> RxFecFailures{0};
+
+	/*!
+	 * \brief Data buffer base addresses last sent to the radio
+	 */
+	std::atomic<uint8_t> TxBaseAddress{0};
+	std::atomic<uint8_t> RxBaseAddress{0};
+
+	/*!
+	 * \brief Continuous RX session state, protected by RxSessionLock
+	 *
+	 * RxBlindSince is 0 while the radio is in RX.
+	 */
+	std::mutex RxSessionLock;
+	std::atomic<bool> RxSessionActive{false};
+	uint64_t RxSessionStart = 0;
+	uint64_t RxSessionEnd = 0;
+	uint64_t RxBlindSince = 0;
+	uint64_t RxBlindTime = 0;
+	uint64_t RxBlindWindows = 0;
+	uint64_t RxLongestBlindWindow = 0;
+	uint64_t RxSessionPackets = 0;
+	uint64_t RxBufferGaps = 0;
+	uint8_t RxBufferPointer = 0;
+	uint8_t RxNextBufferPointer = 0;
+
+	/*!
+	 * \brief Turnaround state, protected by TurnaroundLock
+	 */
+	std::mutex TurnaroundLock;
+	std::atomic<bool> TurnaroundArmed{false};
+	uint8_t TurnaroundSize = 0;
+	uint8_t TurnaroundPayload[TX_HALF_BUFFER_SIZE];
+	uint16_t TurnaroundDelayUs = 0;
+	TickTime_t TurnaroundRxTimeout = {};
+	uint8_t TurnaroundSavedTxBase = 0;
+	uint8_t TurnaroundSavedRxBase = 0;
+	std::atomic<uint64_t> TurnaroundCount{0};
+	std::atomic<uint64_t> TurnaroundCorrupted{0};               //!< Requests that overwrote the response
+
+	/*!
+	 * \brief IRQ mask and DIO masks last sent to the radio, protected by IOLock2
+	 */
+	uint16_t IrqMask = IRQ_RADIO_NONE;
+	uint16_t DioIrqMasks[3] = {};
+	bool DioIrqRouting = false;
+
+	/*!
+	 * \brief Waits for BUSY before a transfer. Must be called with IOLock held.
+	 */
+	void PrepareCommand(void);
+
+	/*!
+	 * \brief Waits for BUSY after a transfer, or only marks the radio as
+	 *        possibly busy in deferred mode. Must be called with IOLock held.
+	 */
+	void CompleteCommand(void);
+
+	/*!
+	 * \brief Writes the 4 header bytes of a read into SpiTxNop
+	 */
+	void SetReadHeader(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3);
+
+	/*!
+	 * \brief Appends a command to the batch of the calling thread
+	 *
+	 * Must be called with IOLock held.
+	 *
+	 * \retval      queued        false if no batch is open on the calling thread
+	 *                            or the command doesn't fit in the batch buffer
+	 */
+	bool BatchCommand(const uint8_t *header, uint16_t headerSize, const uint8_t *buffer, uint16_t size);
+
+	/*!
+	 * \brief Sends the pending batch, if any. Must be called with IOLock held.
+	 */
+	void FlushCommandBatch(void);
+
+	/*!
+	 * \brief Reads and clears the IRQ status in one burst
+	 *
+	 * Sends GET_IRQSTATUS and CLR_IRQSTATUS back to back. With prefetchRx the
+	 * burst also carries GET_RXBUFFERSTATUS and GET_PACKETSTATUS, whose answers
+	 * are then served from a cache to the callbacks of the calling thread.
+	 *
+	 * \param [in]  clearMask     IRQs to clear
+	 * \param [in]  readStatus    Also read the IRQ status before clearing
+	 * \param [in]  prefetchRx    Also fetch the RX buffer and packet status
+	 * \param [out] event         IRQ status before clearing (clearMask if
+	 *                            readStatus is false) and RX status
+	 */
+	void FetchIrqStatus(uint16_t clearMask, bool readStatus, bool prefetchRx, IrqEvent_t& event);
+
+	/*!
+	 * \brief Runs the callbacks of an IRQ event
+	 */
+	void DispatchIrqs(const IrqEvent_t& event);
+
+	/*!
+	 * \brief Returns the dispatch rules of a packet type and operating mode,
+	 *        nullptr when no IRQ is expected there
+	 */
+	static const IrqDispatchEntry_t *GetIrqDispatchEntry(RadioPacketTypes_t packetType, RadioOperatingModes_t mode);
+
+	/*!
+	 * \brief Runs one IRQ action
+	 */
+	void RunIrqAction(IrqAction_t action);
+
+	/*!
+	 * \brief Tells whether an action has any effect with the current
+	 *        callbacks and HAL
+	 */
+	bool IsIrqActionHandled(IrqAction_t action);
+
+	/*!
+	 * \brief Fetches the IRQs, releases IOLock2 and runs the callbacks
+	 *
+	 * \param [in]  lg            Held lock on IOLock2
+	 * \param [in]  clearMask     IRQs to clear
+	 * \param [in]  readStatus    Read the IRQ status, otherwise clearMask is
+	 *                            taken as the IRQs that fired
+	 */
+	void HandleIrqs(std::unique_lock<std::mutex>& lg, uint16_t clearMask, bool readStatus);
+
+	/*!
+	 * \brief Serves the RX status of an event to the calling thread
+	 */
+	void SetIrqStatusCache(const IrqEvent_t& event);
+
+	/*!
+	 * \brief Drops the RX status served by SetIrqStatusCache
+	 */
+	void ReleaseIrqStatusCache(void);
+
+	/*!
+	 * \brief Reads the received packet and its status into a free slot of
+	 *        the RX packet ring, counts an overflow if there is none
+	 */
+	void StoreRxPacket(void);
+
+	/*!
+	 * \brief Loads the oldest packet of the TX queue, or the next one of the
+	 *        TX source, and starts sending it, unless a packet of the queue
+	 *        is already on air
+	 *
+	 * \retval      started       true if a packet was started
+	 */
+	bool StartNextTx(void);
+
+	/*!
+	 * \brief Sends the packet parameters with the size of the packet about
+	 *        to be sent, if the radio has another length
+	 *
+	 * \param [in]  size          Packet size
+	 */
+	void SetTxPayloadLength(uint8_t size);
+
+	/*!
+	 * \brief Sends the configured packet parameters back after
+	 *        SetTxPayloadLength, if their length caps the received packets
+	 */
+	void RestorePayloadLength(void);
+
+	/*!
+	 * \brief Writes packet parameters to the radio without keeping them as
+	 *        the configured ones
+	 */
+	void WritePacketParams(const PacketParams_t& params);
+
+	/*!
+	 * \brief Sets the payload length of packet parameters
+	 *
+	 * \retval      supported     false if the packet type has no payload
+	 *                            length
+	 */
+	static bool SetPacketPayloadLength(PacketParams_t& params, uint8_t size);
+
+	/*!
+	 * \brief Returns the payload length of packet parameters, 0 if the packet
+	 *        type has none
+	 */
+	static uint8_t GetPacketPayloadLength(const PacketParams_t& params);
+
+	/*!
+	 * \brief Returns true if the payload length of packet parameters limits
+	 *        the size of the received packets
+	 */
+	static bool PayloadLengthCapsRx(const PacketParams_t& params);
+
+	/*!
+	 * \brief Ends the transmission of a queued packet and starts the next one
+	 *
+	 * \param [in]  timedOut      The transmission timed out
+	 *
+	 * \retval      started       true if another packet was started
+	 */
+	bool CompleteTx(bool timedOut);
+
+	/*!
+	 * \brief Uploads the packet following the one on air into the free half
+	 *        of the data buffer, in TX double buffering
+	 */
+	void PreloadNextTx(void);
+
+	/*!
+	 * \brief Turns the CRC of packet parameters off
+	 */
+	static void DisablePacketCrc(PacketParams_t& params);
+
+	/*!
+	 * \brief Records a change of operating mode, and the time the receiver
+	 *        spends out of RX during a continuous RX session
+	 */
+	void SetOperatingMode(RadioOperatingModes_t mode);
+
+	/*!
+	 * \brief Puts the radio back in continuous RX after a transmission, if
+	 *        a continuous RX session runs
+	 */
+	void ResumeContinuousRx(void);
+
+	/*!
+	 * \brief Follows the RX buffer start pointer in a continuous RX session
+	 */
+	void TrackRxBuffer(void);
+
+	/*!
+	 * \brief Uploads the turnaround response, arms AutoTx and enters RX.
+	 *        Must be called with TurnaroundLock held.
+	 */
+	void LoadTurnaround(void);
+
+	/*!
+	 * \brief Switches the RF path to TX when a request is received, the
+	 *        radio is sending the response on its own
+	 */
+	void StartTurnaroundTx(void);
+
+	/*!
+	 * \brief Waits for the next request once the response is sent
+	 *
+	 * \retval      armed         false if no turnaround is armed
+	 */
+	bool RearmTurnaround(void);
+
 	/*!
 	 * \brief Compute the two's complement for a register of size lower than
 	 *        32bits
@@ -1224,8 +1876,9 @@ public:
 	/*!
 	 * \brief Set the driver in polling mode.
 	 *
-	 * In polling mode the application is responsible to call ProcessIrqs( ) to
-	 * execute callbacks functions.
+	 * In polling mode the application is responsible to call PollIrqs( ) to
+	 * execute callbacks functions, or to run RunIrqPolling( ) on a thread of
+	 * its own. DIO edges reported by the HAL are only latched.
 	 * The default mode is Interrupt Mode.
 	 * @code
 	 * // Initializations and callbacks declaration/definition
@@ -1236,7 +1889,7 @@ public:
 	 * while( true )
 	 * {
 	 *                            //     IRQ processing is automatically done
-	 *     radio.ProcessIrqs( );  // <-- here, as well as callback functions
+	 *     radio.PollIrqs( );     // <-- here, as well as callback functions
 	 *                            //     calls
 	 *     // Do some applicative work
 	 * }
@@ -1244,7 +1897,7 @@ public:
 	 *
 	 * \see SX1280::SetInterruptMode
 	 */
-//	void SetPollingMode(void);
+	void SetPollingMode(void);
 
 	/*!
 	 * \brief Set the driver in interrupt mode.
@@ -1267,7 +1920,61 @@ public:
 	 *
 	 * \see SX1280::SetPollingMode
 	 */
-//	void SetInterruptMode(void);
+	void SetInterruptMode(void);
+
+	/*!
+	 * \brief Checks once for pending IRQs and processes them
+	 *
+	 * A DIO edge latched in polling mode is processed first. Otherwise, with
+	 * IRQ_POLL_STATUS the IRQ status is read and only the IRQs found are
+	 * cleared and dispatched, which needs no DIO line at all. With
+	 * IRQ_POLL_DIO the DIO levels from GetDioStatus are checked and
+	 * ProcessIrqs runs when one is high, which saves the SPI read while idle.
+	 *
+	 * \param [in]  source        Where to look for pending IRQs
+	 *
+	 * \retval      processed     true if IRQs were processed
+	 */
+	bool PollIrqs(IrqPollSource_t source = IRQ_POLL_STATUS);
+
+	/*!
+	 * \brief Calls PollIrqs until StopIrqPolling is called
+	 *
+	 * \param [in]  periodUs      Poll period [us], 0 to spin without sleeping
+	 * \param [in]  source        Where to look for pending IRQs
+	 */
+	void RunIrqPolling(uint32_t periodUs, IrqPollSource_t source = IRQ_POLL_STATUS);
+
+	/*!
+	 * \brief Makes RunIrqPolling return after its current poll
+	 *
+	 * A stop requested before the polling runs makes it return right away.
+	 */
+	void StopIrqPolling(void);
+
+	/*!
+	 * \brief Starts queuing the write commands of the calling thread
+	 *
+	 * Until the matching EndCommandBatch, WriteCommand, WriteRegister and
+	 * WriteBuffer calls made by this thread are buffered and sent together,
+	 * letting the HAL submit them in a single bus transaction. Any read, and
+	 * any access from another thread, sends the pending commands first so
+	 * the order seen by the radio is preserved. Batches can be nested.
+	 *
+	 * @code
+	 * radio.BeginCommandBatch( );
+	 * radio.SetRfFrequency( 2400000000 );
+	 * radio.SetTxParams( 13, SX128x::RADIO_RAMP_02_US );
+	 * radio.EndCommandBatch( );
+	 * @endcode
+	 */
+	void BeginCommandBatch(void);
+
+	/*!
+	 * \brief Ends a batch started with BeginCommandBatch and sends the queued
+	 *        commands when the outermost batch is closed
+	 */
+	void EndCommandBatch(void);
 
 	/*!
 	 * \brief Initializes the radio registers to the recommended default values
@@ -1284,9 +1991,37 @@ public:
 	/*!
 	 * \brief Used to block execution waiting for low state on radio busy pin.
 	 *        Essentially used in SPI communications
+	 *
+	 * Waits for the BUSY falling edge when the HAL supports it. Otherwise BUSY
+	 * is polled back to back for BUSY_SPIN_TIME_US, then every 10 us.
 	 */
 	void WaitOnBusy();
 
+	/*!
+	 * \brief Enables or disables deferred BUSY checking
+	 *
+	 * Every transfer waits for BUSY before it starts. By default it also
+	 * waits after it completes, so each command returns with the radio idle.
+	 * In deferred mode the driver only marks the radio as possibly busy and
+	 * the check is left to the next transfer, which halves the BUSY waits
+	 * of command sequences. Call WaitOnCommandDone when the completion of
+	 * the last command matters.
+	 *
+	 * \param [in]  enable        true to defer the BUSY checks
+	 */
+	void SetDeferredBusyCheck(bool enable);
+
+	/*!
+	 * \brief Blocks until the last command sent has been processed by the radio
+	 *
+	 * Sends the pending command batch first, if any.
+	 */
+	void WaitOnCommandDone(void);
+
+	/*!
+	 * \brief Same as WaitOnBusy with a longer edge timeout and 1 ms polling,
+	 *        used while the radio wakes up
+	 */
 	void WaitOnBusyLong();
 
 	/*!
@@ -1361,7 +2096,7 @@ public:
 	 * \param [in]  buffer        Buffer pointer
 	 * \param [in]  size          Buffer size
 	 */
-	virtual void WriteBuffer(uint8_t offset, uint8_t *buffer, uint8_t size);
+	virtual void WriteBuffer(uint8_t offset, const uint8_t *buffer, uint8_t size);
 
 	/*!
 	 * \brief Reads Radio Data Buffer at offset to buffer of size
@@ -1571,6 +2306,47 @@ public:
 	 */
 	void SetDioIrqParams(uint16_t irqMask, uint16_t dio1Mask, uint16_t dio2Mask, uint16_t dio3Mask);
 
+	/*!
+	 * \brief   Maps a fixed set of IRQs to each DIO line and enables them
+	 *
+	 * The IRQ mask is the union of the DIO sets. With routing enabled,
+	 * ProcessDioIrq knows which IRQs a DIO edge stands for and skips the
+	 * status read when the line carries a single one.
+	 *
+	 * \param [in]  dio1Irqs      IRQs routed to DIO1
+	 * \param [in]  dio2Irqs      IRQs routed to DIO2
+	 * \param [in]  dio3Irqs      IRQs routed to DIO3
+	 */
+	void SetDioIrqRouting(uint16_t dio1Irqs = IRQ_TX_DONE | IRQ_RX_DONE,
+			      uint16_t dio2Irqs = IRQ_RX_TX_TIMEOUT,
+			      uint16_t dio3Irqs = IRQ_CAD_DONE | IRQ_CAD_DETECTED);
+
+	/*!
+	 * \brief   Disables the DIO routing, every DIO edge reads the IRQ status
+	 */
+	void ClearDioIrqRouting(void);
+
+	/*!
+	 * \brief   Returns the IRQs the driver acts on for a packet type
+	 *
+	 * Only IRQs whose callback is set, or whose handling drives the HAL, are
+	 * included, along with the IRQs that qualify them (e.g. CRC_ERROR for
+	 * RX_DONE).
+	 *
+	 * \param [in]  packetType    Packet type
+	 *
+	 * \retval      irqMask       IRQ mask
+	 */
+	uint16_t GetHandledIrqMask(RadioPacketTypes_t packetType);
+
+	/*!
+	 * \brief   Enables only the IRQs returned by GetHandledIrqMask for the
+	 *          current packet type, all on DIO1
+	 *
+	 * Call it again after changing the packet type or the callbacks.
+	 */
+	void SetDioIrqParamsAuto(void);
+
 	/*!
 	 * \brief Returns the current IRQ status
 	 *
@@ -1640,7 +2416,7 @@ public:
 	 * \param [in]  size          The size of the payload
 	 * \param [in]  offset        The address in FIFO where writting first byte (default = 0x00)
 	 */
-	void SetPayload(uint8_t *payload, uint8_t size, uint8_t offset = 0x00);
+	void SetPayload(const uint8_t *payload, uint8_t size, uint8_t offset = 0x00);
 
 	/*!
 	 * \brief Reads the payload received. If the received payload is longer
@@ -1852,6 +2628,251 @@ public:
 	 */
 	void ProcessIrqs();
 
+	/*!
+	 * \brief Handles an edge on one DIO line
+	 *
+	 * Without routing this is the same as ProcessIrqs. With routing, a line
+	 * carrying a single IRQ is only cleared and dispatched, its status isn't
+	 * read. In polling mode the edge is only latched for PollIrqs.
+	 *
+	 * \param [in]  dio           DIO line number [1..3]
+	 */
+	void ProcessDioIrq(uint8_t dio);
+
+	/*!
+	 * \brief Runs the callbacks on the calling thread until
+	 *        StopCallbackDispatcher is called
+	 *
+	 * While it runs, the IRQ handling only captures the IRQ events and queues
+	 * them, so a slow callback doesn't hold up the next IRQ. Events that
+	 * don't fit in the queue are dropped and counted.
+	 *
+	 * \param [in]  queueSize     Number of events the queue holds
+	 */
+	void RunCallbackDispatcher(size_t queueSize = DISPATCH_QUEUE_SIZE);
+
+	/*!
+	 * \brief Makes RunCallbackDispatcher run the queued callbacks and return
+	 *
+	 * A stop requested before the dispatcher runs makes it return right away.
+	 */
+	void StopCallbackDispatcher(void);
+
+	/*!
+	 * \brief Returns the counters of the callback dispatcher queue
+	 */
+	DispatcherStats_t GetDispatcherStats(void);
+
+	/*!
+	 * \brief Timestamp of the IRQ whose callbacks are running, only
+	 *        meaningful from within a callback
+	 *
+	 * \retval      timestamp     Time in nanoseconds, see HalGetIrqTimestamp
+	 */
+	uint64_t GetIrqTimestamp(void);
+
+	/*!
+	 * \brief Makes the driver store every received packet in a ring of
+	 *        preallocated slots, before the rxDone callback runs
+	 *
+	 * The slots are only allocated here, the RX path itself doesn't
+	 * allocate. Call it while the radio isn't receiving.
+	 *
+	 * \param [in]  slots         Number of packets the ring holds
+	 */
+	void EnableRxPacketRing(size_t slots = RX_RING_SIZE);
+
+	/*!
+	 * \brief Stops storing received packets, the stored ones can still be
+	 *        read
+	 */
+	void DisableRxPacketRing(void);
+
+	/*!
+	 * \brief Takes the oldest packet out of the RX packet ring
+	 *
+	 * Only one thread may receive at a time.
+	 *
+	 * \param [out] packet        Received packet
+	 * \param [in]  timeoutMs     Time to wait for a packet, 0 returns at once
+	 *
+	 * \retval      received      false if no packet came in time
+	 */
+	bool ReceivePacket(RxPacket_t& packet, uint32_t timeoutMs = 0);
+
+	/*!
+	 * \brief Returns the counters of the RX packet ring
+	 */
+	RxRingStats_t GetRxRingStats(void);
+
+	/*!
+	 * \brief Makes QueuePacket usable and enables TX_DONE and RX_TX_TIMEOUT
+	 *        on DIO1 if no DIO carries them yet
+	 *
+	 * The slots are only allocated here. While the queue runs, the end of a
+	 * transmission starts the next queued packet right away, before the
+	 * txDone callback runs. Don't mix it with SendPayload or SetTx.
+	 *
+	 * \param [in]  slots         Number of packets the queue holds
+	 */
+	void EnableTxQueue(size_t slots = TX_QUEUE_SIZE);
+
+	/*!
+	 * \brief Stops sending queued packets once the one on air is done
+	 */
+	void DisableTxQueue(void);
+
+	/*!
+	 * \brief Splits the data buffer in two halves for the TX queue
+	 *
+	 * Queued packets then alternate between the halves: the next packet is
+	 * uploaded into one half while the current one is sent from the other,
+	 * so the end of a transmission only changes the TX base address before
+	 * SetTx. Packets larger than TX_HALF_BUFFER_SIZE are still sent, without
+	 * the overlap. Received packets use the RX base address and may
+	 * overwrite a preloaded packet, so use it for bulk transmission. Call it
+	 * while the TX queue is idle.
+	 *
+	 * \param [in]  enable        Turn on double buffering
+	 */
+	void SetTxDoubleBuffer(bool enable);
+
+	/*!
+	 * \brief Sets a source of packets sent once the TX queue is empty
+	 *
+	 * The source writes each packet into the data buffer itself, so data
+	 * kept elsewhere is sent without being copied into a queue slot first.
+	 * It runs with the TX queue locked, on the thread calling QueuePacket or
+	 * ResumeTxQueue or on the one running the callbacks, and must not call
+	 * back into the TX queue. An empty function removes it.
+	 *
+	 * \param [in]  source        Packet source
+	 */
+	void SetTxSource(TxSource_t source);
+
+	/*!
+	 * \brief Starts the next queued or source packet if none is on air
+	 */
+	void ResumeTxQueue(void);
+
+	/*!
+	 * \brief Protects packets with a Reed-Solomon code instead of the radio
+	 *        CRC
+	 *
+	 * Packets queued by QueuePacket, TX source packets and the turnaround
+	 * response get parity bytes appended, packets stored in the RX packet
+	 * ring are corrected and lose them, or are dropped if too corrupted.
+	 * parity / 2 corrupted bytes are corrected per packet, each packet
+	 * carries parity bytes less payload. While it's on the radio CRC is
+	 * off, whatever SetPacketParams asks for, and the requested CRC comes
+	 * back when it's turned off. It may be called while packets are queued
+	 * or received, those in progress finish with the code they started
+	 * with, so the peer may drop the packets around the change.
+	 *
+	 * \param [in]  parity        Parity bytes per packet, at most
+	 *                            FEC_PARITY_MAX, 0 turns the FEC off
+	 */
+	void SetFec(uint8_t parity);
+
+	/*!
+	 * \brief Returns the parity bytes per packet, 0 when the FEC is off
+	 */
+	uint8_t GetFecParity(void);
+
+	/*!
+	 * \brief Returns the code of the packets, for TX sources appending the
+	 *        parity bytes themselves, or nullptr when the FEC is off. Keep
+	 *        the reference until the packet is encoded.
+	 */
+	std::shared_ptr<const ReedSolomon> GetFec(void);
+
+	/*!
+	 * \brief Starts a continuous RX session
+	 *
+	 * The radio is put in RX with the continuous timeout, so it stays in RX
+	 * after each packet and never has to be re-armed. Packets are drained
+	 * from the IRQ path, by the RX packet ring or the rxDone callback. A
+	 * transmission during the session puts the radio back in RX as soon as
+	 * it ends (or the TX queue is empty). The time the radio spends out of
+	 * RX is reported by GetRxSessionStats.
+	 */
+	void StartContinuousRx(void);
+
+	/*!
+	 * \brief Ends the continuous RX session and puts the radio in standby
+	 */
+	void StopContinuousRx(void);
+
+	/*!
+	 * \brief Returns the counters of the current or last continuous RX
+	 *        session
+	 */
+	RxSessionStats_t GetRxSessionStats(void);
+
+	/*!
+	 * \brief Answers every received packet with a fixed response, sent by the
+	 *        radio itself
+	 *
+	 * The response is uploaded at the end of the data buffer, RX packets
+	 * land at its start. AutoTx makes the radio send the response delayUs
+	 * after RX_DONE without waiting for the host, AutoFs keeps the
+	 * synthesizer running between TX and RX. Once the response is sent the
+	 * driver reloads it and enters RX again, until DisarmTurnaround.
+	 *
+	 * The host still switches a GPIO driven RF path to TX on RX_DONE, so on
+	 * such boards delayUs must cover the IRQ latency. Don't mix it with the
+	 * TX queue or a continuous RX session. Call it again to change the
+	 * response, or the packet parameters.
+	 *
+	 * The RX and the response share the packet parameters. Unless an
+	 * explicit LoRa header carries the length, the response is padded with
+	 * zeros to the configured payload length, and may not exceed it. With an
+	 * explicit LoRa header requests longer than 256 bytes less the response
+	 * overwrite it, see GetTurnaroundCorrupted.
+	 *
+	 * \param [in]  response      Response payload
+	 * \param [in]  size          Response size, at most TX_HALF_BUFFER_SIZE,
+	 *                            FEC parity included
+	 * \param [in]  delayUs       Delay between RX_DONE and the response, more
+	 *                            than AUTO_TX_OFFSET
+	 * \param [in]  rxTimeout     Timeout of each RX
+	 */
+	void ArmTurnaround(const uint8_t *response, uint8_t size, uint16_t delayUs, TickTime_t rxTimeout);
+
+	/*!
+	 * \brief Stops answering received packets, puts the radio in standby and
+	 *        restores the data buffer base addresses
+	 */
+	void DisarmTurnaround(void);
+
+	/*!
+	 * \brief Returns how many responses were sent since ArmTurnaround
+	 */
+	uint64_t GetTurnaroundCount(void);
+
+	/*!
+	 * \brief Returns how many requests since ArmTurnaround were long enough
+	 *        to overwrite the response, which then went out corrupted
+	 */
+	uint64_t GetTurnaroundCorrupted(void);
+
+	/*!
+	 * \brief Queues a packet, and sends it at once if the radio is idle
+	 *
+	 * Only one thread may queue packets at a time.
+	 *
+	 * \param [in]  payload       Packet to send
+	 * \param [in]  size          Packet size
+	 *
+	 * \retval      queued        false if the queue is disabled or full
+	 */
+	bool QueuePacket(const uint8_t *payload, uint8_t size);
+
+	/*!
+	 * \brief Returns the counters of the TX queue
+	 */
+	TxQueueStats_t GetTxQueueStats(void);
+
 	/*!
 	 * \brief Force the preamble length in GFSK and BLE mode
 	 *
@@ -1859,8 +2880,22 @@ public:
 	 */
 	void ForcePreambleLength(RadioPreambleLengths_t preambleLength);
 
+	/*!
+	 * \brief Returns the steady clock in nanoseconds, the time base of the
+	 *        statistics and of the timeouts of the frame layers
+	 */
+	static uint64_t SteadyClockNs(void);
+
 	static uint16_t GetTimeOnAir(const ModulationParams_t &modparams, const PacketParams_t &pktparams);
 
 	uint16_t GetTimeOnAir();
+
+	/*!
+	 * \brief Returns the time on air in milliseconds of a packet of size
+	 *        bytes with the current modulation and packet parameters
+	 *
+	 * \param [in]  size          Packet size, FEC parity included
+	 */
+	uint16_t GetTimeOnAir(uint8_t size);
 };
 
@@ -20,12 +20,20 @@
 
 SX128x_Linux::SX128x_Linux(const std::string &spi_dev_path, uint16_t gpio_dev_num, SX128x_Linux::PinConfig pin_config) :
 	pin_cfg(pin_config),
-	RadioSpi(spi_dev_path, SPI_MODE_0|SPI_NO_CS, 8, 500000),
+	RadioSpi(spi_dev_path, SPI_MODE_0|(pin_config.nss >= 0 ? SPI_NO_CS : 0), 8, 500000),
 	RadioGpio(gpio_dev_num),
-	Busy(RadioGpio.line(pin_cfg.busy, GPIO::LineMode::Input, 0, "SX128x BUSY")),
-	RadioNss(RadioGpio.line(pin_cfg.nss, GPIO::LineMode::Output, 1, "SX128x NSS")),
 	RadioReset(RadioGpio.line(pin_cfg.nrst, GPIO::LineMode::Output, 1, "SX128x NRESET"))
 {
+	try {
+		BusyEvent = RadioGpio.event_line(pin_cfg.busy, GPIO::LineMode::Input, GPIO::EventMode::FallingEdge, "SX128x BUSY");
+	} catch (std::system_error&) {
+		Busy = RadioGpio.line(pin_cfg.busy, GPIO::LineMode::Input, 0, "SX128x BUSY");
+	}
+
+	if (pin_config.nss >= 0) {
+		RadioNss = RadioGpio.line(pin_cfg.nss, GPIO::LineMode::Output, 1, "SX128x NSS");
+	}
+
 	if (pin_config.tx_en >= 0) {
 		TxEn = RadioGpio.line(pin_cfg.tx_en, GPIO::LineMode::Output, 0, "SX128x TXEN");
 	}
@@ -34,21 +42,26 @@ SX128x_Linux::SX128x_Linux(const std::string &spi_dev_path, uint16_t gpio_dev_nu
 		RxEn = RadioGpio.line(pin_cfg.rx_en, GPIO::LineMode::Output, 0, "SX128x RXEN");
 	}
 
-	int i = 1;
-	for (auto it : {pin_config.dio1, pin_config.dio2, pin_config.dio3}) {
-		std::string label = "SX128x DIO";
-		label += std::to_string(i);
-		i++;
+	// All DIO lines share one request, so one fd carries every IRQ edge.
+	// BUSY keeps its own request since it's waited on outside the listener.
+	std::vector<GPIO::LineConfig> dio_lines;
 
+	uint8_t dio = 1;
+	for (auto it : {pin_config.dio1, pin_config.dio2, pin_config.dio3}) {
 		if (it != -1) {
-         //cfs error: ‘class YukiWorkshop::GPIO::Device’ has no member named ‘on_event’; did you mean ‘add_event’?
-			//cfs RadioGpio.on_event(it, GPIO::LineMode::Input, GPIO::EventMode::RisingEdge,
-         RadioGpio.add_event(it, GPIO::LineMode::Input, GPIO::EventMode::RisingEdge, //cfs
-					   [this](GPIO::EventType t, uint64_t) {
-						   if (t == GPIO::EventType::RisingEdge)
-							   ProcessIrqs();
-					   }, label);
+			dio_lines.push_back({(uint32_t)it, GPIO::LineMode::Input, GPIO::EventMode::RisingEdge});
+			DioRequestOrder[DioRequestCount++] = dio;
 		}
+		dio++;
+	}
+
+	if (!dio_lines.empty()) {
+		DioEventHandle = RadioGpio.add_event(dio_lines, [this](const GPIO::LineEventData& e) {
+			if (e.type == GPIO::EventType::RisingEdge) {
+				LastIrqTimestamp = e.timestamp;
+				ProcessDioIrq(DioNumber(e.line_number));
+			}
+		}, "SX128x DIO");
 	}
 }
 
@@ -56,6 +69,42 @@ void SX128x_Linux::SetSpiSpeed(uint32_t hz) {
 	RadioSpi.set_max_speed_hz(hz);
 }
 
+double SX128x_Linux::MeasureCommandRate(uint32_t count) {
+	auto t_start = std::chrono::steady_clock::now();
+
+	for (uint32_t i = 0; i < count; i++) {
+		GetStatus();
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t_start;
+
+	return elapsed.count() > 0 ? count / elapsed.count() : 0;
+}
+
+void SX128x_Linux::SetSpiExclusive(bool exclusive) {
+	RadioSpi.set_exclusive(exclusive);
+}
+
+uint8_t SX128x_Linux::DioNumber(uint32_t line) const {
+	if ((int32_t)line == pin_cfg.dio1) {
+		return 1;
+	} else if ((int32_t)line == pin_cfg.dio2) {
+		return 2;
+	} else if ((int32_t)line == pin_cfg.dio3) {
+		return 3;
+	}
+
+	return 0;
+}
+
+uint64_t SX128x_Linux::GetLastIrqTimestamp() const {
+	return LastIrqTimestamp;
+}
+
+GPIO::EventStats SX128x_Linux::GetIrqEventStats() {
+	return DioEventHandle >= 0 ? RadioGpio.event_stats(DioEventHandle) : GPIO::EventStats{};
+}
+
 void SX128x_Linux::SetExternalLock(std::mutex &m) {
 	ExtLock = &m;
 }
@@ -65,6 +114,7 @@ void SX128x_Linux::StartIrqHandler(int __prio) {
 		sched_param param;
 		param.sched_priority = __prio;
 		pthread_setschedparam(pthread_self(), SCHED_RR, &param);
+		IrqThreadId = std::this_thread::get_id();
 		RadioGpio.run_eventlistener();
 	});
 }
@@ -74,15 +124,91 @@ void SX128x_Linux::StopIrqHandler() {
 	IrqThread.join();
 }
 
+void SX128x_Linux::StartPollThread(uint32_t period_us, int cpu, int __prio, IrqPollSource_t source) {
+	SetPollingMode();
+
+	PollThread = std::thread([this, period_us, cpu, __prio, source](){
+		sched_param param;
+		param.sched_priority = __prio;
+		pthread_setschedparam(pthread_self(), SCHED_RR, &param);
+
+		if (cpu >= 0) {
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			CPU_SET(cpu, &cpus);
+			pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		}
+
+		RunIrqPolling(period_us, source);
+	});
+}
+
+void SX128x_Linux::StopPollThread() {
+	StopIrqPolling();
+	PollThread.join();
+
+	SetInterruptMode();
+}
+
+uint8_t SX128x_Linux::GetDioStatus() {
+	uint8_t status = HalGpioRead(GPIO_PIN_BUSY);
+
+	if (DioEventHandle >= 0) {
+		uint64_t values = RadioGpio.event_values(DioEventHandle);
+
+		for (uint8_t i = 0; i < DioRequestCount; i++) {
+			if (values & (1ULL << i)) {
+				status |= 1 << DioRequestOrder[i];
+			}
+		}
+	}
+
+	return status;
+}
+
+void SX128x_Linux::StartCallbackThread(int __prio, size_t queue_size) {
+	CallbackThread = std::thread([this, __prio, queue_size](){
+		sched_param param;
+		param.sched_priority = __prio;
+		pthread_setschedparam(pthread_self(), SCHED_RR, &param);
+		RunCallbackDispatcher(queue_size);
+	});
+}
+
+void SX128x_Linux::StopCallbackThread() {
+	StopCallbackDispatcher();
+	CallbackThread.join();
+}
+
 uint8_t SX128x_Linux::HalGpioRead(SX128x::GpioPinFunction_t func) {
 	switch (func) {
 		case SX128x::GPIO_PIN_BUSY:
-			return Busy.read();
+			return BusyEvent ? BusyEvent->read() : Busy->read();
 		default:
 			return 0;
 	}
 }
 
+bool SX128x_Linux::HalWaitOnBusy(uint32_t timeout_us) {
+	if (!BusyEvent) {
+		return false;
+	}
+
+	if (!BusyEvent->read()) {
+		return true;
+	}
+
+	// Drop the edges of earlier commands, then check again in case BUSY
+	// fell before the queue was drained
+	BusyEvent->drain();
+
+	if (!BusyEvent->read()) {
+		return true;
+	}
+
+	return BusyEvent->wait(std::chrono::microseconds(timeout_us));
+}
+
 void SX128x_Linux::HalGpioWrite(SX128x::GpioPinFunction_t func, uint8_t value) {
 	switch (func) {
 		case SX128x::GPIO_PIN_RESET:
@@ -93,16 +219,97 @@ void SX128x_Linux::HalGpioWrite(SX128x::GpioPinFunction_t func, uint8_t value) {
 }
 
 void SX128x_Linux::HalSpiTransfer(uint8_t *buffer_in, const uint8_t *buffer_out, uint16_t size) {
+	std::unique_lock<std::mutex> lg;
+
 	if (ExtLock) {
-		std::lock_guard<std::mutex> lg(*ExtLock);
+		lg = std::unique_lock<std::mutex>(*ExtLock);
+	}
 
-		RadioNss.write(0);
+	if (RadioNss) {
+		RadioNss->write(0);
 		RadioSpi.transfer(buffer_out, buffer_in, size);
-		RadioNss.write(1);
+		RadioNss->write(1);
 	} else {
-		RadioNss.write(0);
-		RadioSpi.transfer(buffer_out, buffer_in, size);
-		RadioNss.write(1);
+		// cs_change on the last transfer would keep CS asserted after the message
+		RadioSpi.transfer(buffer_out, buffer_in, size, false);
+	}
+}
+
+void SX128x_Linux::HalSpiTransferBatch(uint8_t *buffer_in, const uint8_t *buffer_out, const uint16_t *sizes, uint16_t count) {
+	// A GPIO driven NSS can't be toggled inside a SPI message
+	if (RadioNss) {
+		SX128x::HalSpiTransferBatch(buffer_in, buffer_out, sizes, count);
+		return;
+	}
+
+	RadioSpiBatch.clear();
+
+	for (uint16_t i = 0; i < count; i++) {
+		// cs_change releases CS between commands, the SPI core then keeps it
+		// inactive for its fixed cs_change delay (10 us) and asserts it again
+		// for the next command. That gap covers the BUSY time of the short
+		// commands only, a delay_usecs would run before CS is released, so
+		// the message ends after the commands that keep BUSY high longer and
+		// BUSY is waited on before the rest.
+		bool last = ( i == count-1 );
+		bool longBusy = false;
+
+		switch (buffer_out[0]) {
+			case RADIO_SET_BUFFERBASEADDRESS:
+			case RADIO_SET_AUTOFS:
+			case RADIO_SET_AUTOTX:
+				longBusy = !last;
+				break;
+			default:
+				break;
+		}
+
+		// cs_change on the last transfer would keep CS asserted after the message
+		RadioSpiBatch.add(buffer_out, buffer_in, sizes[i], 0, !last && !longBusy);
+		if (buffer_in) {
+			buffer_in += sizes[i];
+		}
+		buffer_out += sizes[i];
+
+		if (longBusy) {
+			TransferBatchList();
+			RadioSpiBatch.clear();
+			WaitOnBusy();
+		}
+	}
+
+	TransferBatchList();
+}
+
+void SX128x_Linux::TransferBatchList(void) {
+	std::unique_lock<std::mutex> lg;
+
+	if (ExtLock) {
+		lg = std::unique_lock<std::mutex>(*ExtLock);
+	}
+
+	RadioSpi.transfer(RadioSpiBatch);
+}
+
+void SX128x_Linux::HalSpiTransferChained(const uint8_t *header, uint16_t header_size, uint8_t *data_in, const uint8_t *data_out, uint16_t data_size) {
+	// Two segments, cs_change=0 keeps CS asserted between them and releases
+	// it at the end of the message
+	RadioSpiChain.clear();
+	RadioSpiChain.add(header, nullptr, header_size, 0, false);
+	RadioSpiChain.add(data_out, data_in, data_size, 0, false);
+
+	std::unique_lock<std::mutex> lg;
+
+	if (ExtLock) {
+		lg = std::unique_lock<std::mutex>(*ExtLock);
+	}
+
+	if (RadioNss) {
+		RadioNss->write(0);
+		RadioSpi.transfer(RadioSpiChain);
+		RadioNss->write(1);
+	} else {
+		RadioSpi.transfer(RadioSpiChain);
 	}
 }
 
@@ -130,3 +337,13 @@ void SX128x_Linux::HalPostRx() {
 	}
 }
 
+uint64_t SX128x_Linux::HalGetIrqTimestamp() {
+	// The edge timestamp belongs to the IRQ the listener thread is handling,
+	// ProcessIrqs calls from other threads get the current time
+	if (std::this_thread::get_id() == IrqThreadId) {
+		return LastIrqTimestamp;
+	}
+
+	return SX128x::HalGetIrqTimestamp();
+}
+
@@ -24,6 +24,7 @@
 #include <string>
 #include <thread>
 #include <optional>
+#include <atomic>
 
 #include <cinttypes>
 
@@ -31,6 +32,7 @@ using namespace YukiWorkshop;
 
 class SX128x_Linux : public SX128x {
 public:
+	// Set nss to -1 to let the spidev controller drive the chip select
 	struct PinConfig {
 		int16_t busy = -1, nrst = -1, nss = -1, dio1 = -1, dio2 = -1, dio3 = -1;
 		int16_t tx_en = -1, rx_en = -1;
@@ -45,34 +47,89 @@ public:
 
 	void StopIrqHandler();
 
+	// Polls for IRQs on a thread instead of waiting for DIO edges, for boards
+	// without DIO lines or to trade a core for lower latency. A period of 0
+	// spins, cpu >= 0 pins the thread to that core.
+	void StartPollThread(uint32_t period_us, int cpu = -1, int __prio = 50, IrqPollSource_t source = IRQ_POLL_STATUS);
+
+	void StopPollThread();
+
+	// Bit #3: DIO3, Bit #2: DIO2, Bit #1: DIO1, Bit #0: BUSY
+	uint8_t GetDioStatus() override;
+
+	// Runs the callbacks on their own thread instead of the IRQ thread
+	void StartCallbackThread(int __prio = 40, size_t queue_size = DISPATCH_QUEUE_SIZE);
+
+	void StopCallbackThread();
+
 	void SetSpiSpeed(uint32_t hz);
 
+	// Take exclusive ownership of the spidev device, transfers then skip flock()
+	void SetSpiExclusive(bool exclusive);
+
+	// Kernel timestamp (CLOCK_MONOTONIC, ns) of the last DIO edge
+	uint64_t GetLastIrqTimestamp() const;
+
+	// Event counters of the DIO lines, overruns are edges the kernel dropped
+	GPIO::EventStats GetIrqEventStats();
+
+	// Sends count GetStatus commands and returns the achieved commands per second
+	double MeasureCommandRate(uint32_t count);
+
 private:
 	PinConfig pin_cfg;
 
 	std::mutex* ExtLock = nullptr;
 
 	std::thread IrqThread;
+	std::thread CallbackThread;
+	std::thread PollThread;
+	std::atomic<std::thread::id> IrqThreadId;
+
+	std::atomic<uint64_t> LastIrqTimestamp{0};
+
+	int DioEventHandle = -1;
+
+	// DIO numbers in the order the lines were requested
+	uint8_t DioRequestOrder[3] = {};
+	uint8_t DioRequestCount = 0;
 
 	SPPI RadioSpi;
+	SPPI_TransferList RadioSpiBatch{BATCH_MAX_COMMANDS};
+	SPPI_TransferList RadioSpiChain{2};
 	GPIO::Device RadioGpio;
 
    //cfs error: ‘SX128x_Linux::Busy’ will be initialized after ‘YukiWorkshop::GPIO::LineSingle SX128x_Linux::RadioNs’
 	//cfs GPIO::LineSingle RadioNss;
 	//cfs GPIO::LineSingle RadioReset;
 	//cfs GPIO::LineSingle Busy;
-   GPIO::LineSingle Busy;       //cfs Changed order to match SX128x_Linux.cpp construction order
-   GPIO::LineSingle RadioNss;   //cfs 
 	GPIO::LineSingle RadioReset; //cfs 
 
-	std::optional<GPIO::LineSingle> TxEn, RxEn;
+	// BUSY is requested as a falling edge event line when the GPIO controller
+	// supports it, as a plain input otherwise
+	std::optional<GPIO::LineEvent> BusyEvent;
+	std::optional<GPIO::LineSingle> Busy;
+
+	std::optional<GPIO::LineSingle> RadioNss, TxEn, RxEn;
+
+	// Maps a GPIO line offset to its DIO number, 0 if it's not a DIO
+	uint8_t DioNumber(uint32_t line) const;
 
 	uint8_t HalGpioRead(GpioPinFunction_t func) override;
 
+	bool HalWaitOnBusy(uint32_t timeout_us) override;
+
 	void HalGpioWrite(GpioPinFunction_t func, uint8_t value) override;
 
 	void HalSpiTransfer(uint8_t *buffer_in, const uint8_t *buffer_out, uint16_t size) override;
 
+	void HalSpiTransferBatch(uint8_t *buffer_in, const uint8_t *buffer_out, const uint16_t *sizes, uint16_t count) override;
+
+	// Sends RadioSpiBatch as one SPI message
+	void TransferBatchList(void);
+
+	void HalSpiTransferChained(const uint8_t *header, uint16_t header_size, uint8_t *data_in, const uint8_t *data_out, uint16_t data_size) override;
+
 	void HalPreTx() override;
 
 	void HalPreRx() override;
@@ -81,4 +138,6 @@ private:
 
 	void HalPostRx() override;
 
+	uint64_t HalGetIrqTimestamp() override;
+
 };
\ No newline at end of file
@@ -0,0 +1,178 @@
+/*
+    This file is part of SX128x Linux driver.
+    Copyright (C) 2020 ReimuNotMoe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include <cstddef>
+#include <cinttypes>
+
+// Lock-free ring for one producer thread and one consumer thread. The
+// capacity is rounded up to a power of two and allocated once by reset(),
+// push() and pop() never allocate.
+template <typename T>
+class SpscRing {
+private:
+	static constexpr size_t CACHE_LINE_SIZE = 64;
+
+	std::vector<T> slots_;
+	size_t mask_ = 0;
+
+	// Written by the consumer
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_{0};
+
+	// Written by the producer
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_{0};
+	std::atomic<size_t> high_water_mark_{0};
+	std::atomic<uint64_t> drops_{0};
+
+public:
+	SpscRing() = default;
+
+	explicit SpscRing(size_t __capacity) {
+		reset(__capacity);
+	}
+
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+	// Not thread safe, call it while neither side is running
+	void reset(size_t __capacity) {
+		size_t capacity = 1;
+
+		while (capacity < __capacity)
+			capacity <<= 1;
+
+		slots_.assign(capacity, T());
+		mask_ = capacity - 1;
+		head_ = 0;
+		tail_ = 0;
+		high_water_mark_ = 0;
+		drops_ = 0;
+	}
+
+	size_t capacity() const noexcept {
+		return slots_.size();
+	}
+
+	size_t size() const noexcept {
+		return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+	}
+
+	bool empty() const noexcept {
+		return size() == 0;
+	}
+
+	// Producer side, returns false and counts a drop when the ring is full
+	bool push(const T& __item) {
+		size_t tail = tail_.load(std::memory_order_relaxed);
+		size_t used = tail - head_.load(std::memory_order_acquire);
+
+		if (used >= slots_.size()) {
+			drops_.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		slots_[tail & mask_] = __item;
+		tail_.store(tail + 1, std::memory_order_release);
+
+		if (used + 1 > high_water_mark_.load(std::memory_order_relaxed))
+			high_water_mark_.store(used + 1, std::memory_order_relaxed);
+
+		return true;
+	}
+
+	// Producer side, the free slot the next commit() publishes, so it can be
+	// filled in place. Returns nullptr and counts a drop when the ring is full
+	T *claim() {
+		size_t tail = tail_.load(std::memory_order_relaxed);
+
+		if (tail - head_.load(std::memory_order_acquire) >= slots_.size()) {
+			drops_.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		return &slots_[tail & mask_];
+	}
+
+	// Producer side, publishes the slot returned by claim()
+	void commit() {
+		size_t tail = tail_.load(std::memory_order_relaxed);
+		size_t used = tail + 1 - head_.load(std::memory_order_acquire);
+
+		tail_.store(tail + 1, std::memory_order_release);
+
+		if (used > high_water_mark_.load(std::memory_order_relaxed))
+			high_water_mark_.store(used, std::memory_order_relaxed);
+	}
+
+	// Consumer side, returns false when the ring is empty
+	bool pop(T& __item) {
+		size_t head = head_.load(std::memory_order_relaxed);
+
+		if (head == tail_.load(std::memory_order_acquire))
+			return false;
+
+		__item = slots_[head & mask_];
+		head_.store(head + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	// Consumer side, drops the oldest item, returns false when the ring is empty
+	bool pop() {
+		size_t head = head_.load(std::memory_order_relaxed);
+
+		if (head == tail_.load(std::memory_order_acquire))
+			return false;
+
+		head_.store(head + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	// Consumer side, the oldest item or nullptr, stays in the ring until pop()
+	T *front() {
+		size_t head = head_.load(std::memory_order_relaxed);
+
+		if (head == tail_.load(std::memory_order_acquire))
+			return nullptr;
+
+		return &slots_[head & mask_];
+	}
+
+	// Consumer side, the item with index older ones before it or nullptr
+	T *at(size_t __index) {
+		size_t head = head_.load(std::memory_order_relaxed);
+
+		if (tail_.load(std::memory_order_acquire) - head <= __index)
+			return nullptr;
+
+		return &slots_[(head + __index) & mask_];
+	}
+
+	size_t high_water_mark() const noexcept {
+		return high_water_mark_.load(std::memory_order_relaxed);
+	}
+
+	uint64_t drops() const noexcept {
+		return drops_.load(std::memory_order_relaxed);
+	}
+};
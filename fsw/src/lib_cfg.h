@@ -56,6 +56,20 @@
 #define CFG_RADIO_SPI_DEV_STR  RADIO_SPI_DEV_STR
 #define CFG_RADIO_SPI_DEV_NUM  RADIO_SPI_DEV_NUM
 #define CFG_RADIO_SPI_SPEED    RADIO_SPI_SPEED
+#define CFG_RADIO_SPI_CS_MODE  RADIO_SPI_CS_MODE
+#define CFG_RADIO_SPI_EXCLUSIVE RADIO_SPI_EXCLUSIVE
+#define CFG_RADIO_DEFERRED_BUSY RADIO_DEFERRED_BUSY
+#define CFG_RADIO_RX_PACKET_SLOTS RADIO_RX_PACKET_SLOTS
+#define CFG_RADIO_TX_QUEUE_SLOTS RADIO_TX_QUEUE_SLOTS
+#define CFG_RADIO_TX_DOUBLE_BUFFER RADIO_TX_DOUBLE_BUFFER
+#define CFG_RADIO_FRAG_SLOTS   RADIO_FRAG_SLOTS
+#define CFG_RADIO_FRAG_MAX_LEN RADIO_FRAG_MAX_LEN
+#define CFG_RADIO_FRAG_TIMEOUT_MS RADIO_FRAG_TIMEOUT_MS
+#define CFG_RADIO_AGG_MAX_FRAME_LEN RADIO_AGG_MAX_FRAME_LEN
+#define CFG_RADIO_AGG_MAX_DELAY_MS  RADIO_AGG_MAX_DELAY_MS
+#define CFG_RADIO_FEC_PARITY   RADIO_FEC_PARITY
+#define CFG_RADIO_ARQ_WINDOW   RADIO_ARQ_WINDOW
+#define CFG_RADIO_ARQ_MARGIN_MS RADIO_ARQ_MARGIN_MS
 #define CFG_RADIO_PIN_BUSY     RADIO_PIN_BUSY
 #define CFG_RADIO_PIN_NRST     RADIO_PIN_NRST
 #define CFG_RADIO_PIN_NSS      RADIO_PIN_NSS
@@ -69,6 +83,20 @@
    XX(RADIO_SPI_DEV_STR,char*) \
    XX(RADIO_SPI_DEV_NUM,uint32) \
    XX(RADIO_SPI_SPEED,uint32) \
+   XX(RADIO_SPI_CS_MODE,uint32) \
+   XX(RADIO_SPI_EXCLUSIVE,uint32) \
+   XX(RADIO_DEFERRED_BUSY,uint32) \
+   XX(RADIO_RX_PACKET_SLOTS,uint32) \
+   XX(RADIO_TX_QUEUE_SLOTS,uint32) \
+   XX(RADIO_TX_DOUBLE_BUFFER,uint32) \
+   XX(RADIO_FRAG_SLOTS,uint32) \
+   XX(RADIO_FRAG_MAX_LEN,uint32) \
+   XX(RADIO_FRAG_TIMEOUT_MS,uint32) \
+   XX(RADIO_AGG_MAX_FRAME_LEN,uint32) \
+   XX(RADIO_AGG_MAX_DELAY_MS,uint32) \
+   XX(RADIO_FEC_PARITY,uint32) \
+   XX(RADIO_ARQ_WINDOW,uint32) \
+   XX(RADIO_ARQ_MARGIN_MS,uint32) \
    XX(RADIO_PIN_BUSY,uint32) \
    XX(RADIO_PIN_NRST,uint32) \
    XX(RADIO_PIN_NSS,uint32) \
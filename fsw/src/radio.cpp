@@ -31,7 +31,11 @@
 */
 
 #include <string.h>
+#include <chrono>
 #include "SX128x_Linux.hpp"
+#include "Fragmenter.hpp"
+#include "Aggregator.hpp"
+#include "Arq.hpp"
 extern "C"
 {
    #include "sx128x_lib.h"
@@ -45,48 +49,964 @@ extern "C"
 // Pins based on hardware configuration
 SX128x_Linux *Radio = NULL;
 
+static Fragmenter *Frag = NULL;
+
+static Aggregator *Agg = NULL;
+static SX128x::RxPacket_t AggRxPacket;
+static uint8_t AggRxOffset = 0;
+static bool AggRxPending = false;
+
+static Arq *ArqLink = NULL;
+
+static bool IrqHandlerStarted = false;
+
 
 /*******************************/
 /** Local Function Prototypes **/
 /*******************************/
 
+static bool StartIrqHandler(void);
+
+/******************************************************************************
+** Function: RADIO_Constructor
+**
+** Initialize the Radio object to a known state
+**
+** Notes:
+**   1. This must be called prior to any other function.
+**
+*/
+bool RADIO_Constructor(const char *SpiDevStr, uint8_t SpiDevNum, const RADIO_Pin_t *RadioPin,
+                       RADIO_SpiCsMode_t SpiCsMode)
+{
+   bool RetStatus = false;
+   
+   SX128x_Linux::PinConfig PinConfig;
+   
+   PinConfig.busy  = RadioPin->Busy;
+   PinConfig.nrst  = RadioPin->Nrst;
+   PinConfig.nss   = (SpiCsMode == RADIO_SPI_CS_HW) ? -1 : RadioPin->Nss;
+   PinConfig.dio1  = RadioPin->Dio1;
+   PinConfig.dio2  = RadioPin->Dio2;
+   PinConfig.dio3  = RadioPin->Dio3;
+   PinConfig.tx_en = RadioPin->TxEn;
+   PinConfig.rx_en = RadioPin->RxEn;
+   
+   try
+   {
+      Radio = new SX128x_Linux(SpiDevStr, SpiDevNum, PinConfig);
+      RetStatus = true;
+   }
+   catch (...)
+   {
+      RetStatus = false;
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_Constructor() */
+
+
+/******************************************************************************
+** Function: RADIO_ArmTurnaround
+**
+** Answer every received packet with a fixed response sent by the radio
+**
+** Notes:
+**   1. See radio.h
+**
+*/
+bool RADIO_ArmTurnaround(const uint8_t *Response, uint8_t Length, uint16_t DelayUs)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized())
+   {
+      try
+      {
+         Radio->SetDioIrqParamsAuto();
+         Radio->ArmTurnaround(Response, Length, DelayUs, Radio->RX_TX_SINGLE);
+         RetStatus = true;
+      }
+      catch (...)
+      {
+         RetStatus = false;
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_ArmTurnaround() */
+
+
+/******************************************************************************
+** Function: RADIO_ArqProcess
+**
+** Run the ARQ until a frame comes in, for up to TimeoutMs
+**
+** Notes:
+**   1. See radio.h
+**   2. Waits for packets no longer than the ARQ needs before its next
+**      retransmission
+**   3. Starts continuous RX if it isn't running
+**
+*/
+bool RADIO_ArqProcess(uint32_t TimeoutMs)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized() && ArqLink != NULL)
+   {
+      auto Deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TimeoutMs);
+      SX128x::RxPacket_t Packet;
+      
+      try
+      {
+         // The acks and the data of the peer only come in while the radio
+         // listens, and only continuous RX comes back after each transmission
+         if (!Radio->GetRxSessionStats().Active)
+         {
+            Radio->SetDioIrqParamsAuto();
+            Radio->StartContinuousRx();
+         }
+         
+         while (!RetStatus)
+         {
+            ArqLink->Poll();
+            
+            auto Remaining = std::chrono::duration_cast<std::chrono::milliseconds>(Deadline - std::chrono::steady_clock::now());
+            uint32_t Wait = std::min<uint32_t>(Remaining.count() > 0 ? (uint32_t)Remaining.count() : 0,
+                                               ArqLink->PollIntervalMs());
+            
+            if (Radio->ReceivePacket(Packet, Wait))
+            {
+               RetStatus = ArqLink->Input(Packet.Payload, Packet.Size);
+            }
+            else if (Remaining.count() <= 0)
+            {
+               break;
+            }
+         }
+      }
+      catch (...)
+      {
+         RetStatus = false;
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_ArqProcess() */
+
+
+/******************************************************************************
+** Function: RADIO_ArqReceive
+**
+** Take the next received payload, in the order it was sent
+**
+** Notes:
+**   1. See radio.h
+**
+*/
+bool RADIO_ArqReceive(uint8_t *Data, uint8_t *Length)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized() && ArqLink != NULL)
+   {
+      RetStatus = ArqLink->Receive(Data, *Length);
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_ArqReceive() */
+
+
+/******************************************************************************
+** Function: RADIO_ArqSend
+**
+** Queue a payload for reliable delivery
+**
+** Notes:
+**   1. See radio.h
+**
+*/
+bool RADIO_ArqSend(const uint8_t *Data, uint8_t Length)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized() && ArqLink != NULL)
+   {
+      RetStatus = ArqLink->Send(Data, Length);
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_ArqSend() */
+
+
+/******************************************************************************
+** Function: RADIO_DisarmTurnaround
+**
+** Stop answering received packets and put the radio in standby
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_DisarmTurnaround(void)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized())
+   {
+      Radio->DisarmTurnaround();
+      RetStatus = true;
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_DisarmTurnaround() */
+
+
+/******************************************************************************
+** Function: RADIO_EnableAggregation
+**
+** Make RADIO_SendAggregated() and RADIO_ReceiveAggregated() usable
+**
+** Notes:
+**   1. Called during library initialization, before SX128X_Initialized()
+**      reports true
+**
+*/
+bool RADIO_EnableAggregation(uint8_t MaxFrameLength, uint32_t MaxDelayMs)
+{
+   
+   bool RetStatus = false;
+   
+   if (Radio != NULL && Agg == NULL)
+   {
+      try
+      {
+         Agg = new Aggregator(*Radio, MaxFrameLength, MaxDelayMs);
+         RetStatus = true;
+      }
+      catch (...)
+      {
+         RetStatus = false;
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_EnableAggregation() */
+
+
+/******************************************************************************
+** Function: RADIO_EnableArq
+**
+** Make RADIO_ArqSend(), RADIO_ArqReceive() and RADIO_ArqProcess() usable
+**
+** Notes:
+**   1. Called during library initialization, before SX128X_Initialized()
+**      reports true
+**
+*/
+bool RADIO_EnableArq(uint8_t Window, uint32_t MarginMs)
+{
+   
+   bool RetStatus = false;
+   
+   if (Radio != NULL && ArqLink == NULL)
+   {
+      try
+      {
+         ArqLink = new Arq(*Radio, Window, MarginMs);
+         RetStatus = true;
+      }
+      catch (...)
+      {
+         RetStatus = false;
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_EnableArq() */
+
+
+/******************************************************************************
+** Function: RADIO_EnableFragmentation
+**
+** Make RADIO_SendMessage() and RADIO_ReceiveMessage() usable
+**
+** Notes:
+**   1. Called during library initialization, before SX128X_Initialized()
+**      reports true
+**
+*/
+bool RADIO_EnableFragmentation(uint16_t Slots, uint16_t MaxLength, uint32_t TimeoutMs)
+{
+   
+   bool RetStatus = false;
+   
+   if (Radio != NULL && Frag == NULL)
+   {
+      try
+      {
+         Frag = new Fragmenter(*Radio, Slots, MaxLength, TimeoutMs);
+         RetStatus = true;
+      }
+      catch (...)
+      {
+         RetStatus = false;
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_EnableFragmentation() */
+
+
+/******************************************************************************
+** Function: RADIO_EnableRxPacketRing
+**
+** Make the library store received packets in a pool of preallocated slots
+**
+** Notes:
+**   1. Called during library initialization, before SX128X_Initialized()
+**      reports true
+**
+*/
+bool RADIO_EnableRxPacketRing(uint16_t Slots)
+{
+   
+   bool RetStatus = false;
+   
+   if (Radio != NULL && Slots > 0)
+   {
+      try
+      {
+         Radio->EnableRxPacketRing(Slots);
+         RetStatus = StartIrqHandler();
+      }
+      catch (...)
+      {
+         RetStatus = false;
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_EnableRxPacketRing() */
+
+
+/******************************************************************************
+** Function: RADIO_EnableTxQueue
+**
+** Make the library queue packets passed to RADIO_SendPacket()
+**
+** Notes:
+**   1. Called during library initialization, before SX128X_Initialized()
+**      reports true
+**
+*/
+bool RADIO_EnableTxQueue(uint16_t Slots)
+{
+   
+   bool RetStatus = false;
+   
+   if (Radio != NULL && Slots > 0)
+   {
+      try
+      {
+         Radio->EnableTxQueue(Slots);
+         RetStatus = StartIrqHandler();
+      }
+      catch (...)
+      {
+         RetStatus = false;
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_EnableTxQueue() */
+
+
+/******************************************************************************
+** Function: RADIO_GetAggStats
+**
+** Report the aggregation counters
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_GetAggStats(RADIO_AggStats_t *AggStats)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized() && Agg != NULL)
+   {
+      Aggregator::Stats_t Stats = Agg->GetStats();
+      
+      AggStats->MessagesSent     = (uint32_t)Stats.MessagesSent;
+      AggStats->FramesSent       = (uint32_t)Stats.FramesSent;
+      AggStats->SizeFlushes      = (uint32_t)Stats.SizeFlushes;
+      AggStats->AgeFlushes       = (uint32_t)Stats.AgeFlushes;
+      AggStats->Drops            = (uint32_t)Stats.Drops;
+      AggStats->FramesReceived   = (uint32_t)Stats.FramesReceived;
+      AggStats->MessagesReceived = (uint32_t)Stats.MessagesReceived;
+      AggStats->BadFrames        = (uint32_t)Stats.BadFrames;
+      RetStatus = true;
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_GetAggStats() */
+
+
+/******************************************************************************
+** Function: RADIO_GetArqStats
+**
+** Report the ARQ counters
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_GetArqStats(RADIO_ArqStats_t *ArqStats)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized() && ArqLink != NULL)
+   {
+      Arq::Stats_t Stats = ArqLink->GetStats();
+      
+      ArqStats->FramesSent      = (uint32_t)Stats.FramesSent;
+      ArqStats->Retransmissions = (uint32_t)Stats.Retransmissions;
+      ArqStats->AckTimeouts     = (uint32_t)Stats.AckTimeouts;
+      ArqStats->AcksSent        = (uint32_t)Stats.AcksSent;
+      ArqStats->AcksReceived    = (uint32_t)Stats.AcksReceived;
+      ArqStats->FramesReceived  = (uint32_t)Stats.FramesReceived;
+      ArqStats->Duplicates      = (uint32_t)Stats.Duplicates;
+      ArqStats->OutOfWindow     = (uint32_t)Stats.OutOfWindow;
+      ArqStats->Delivered       = (uint32_t)Stats.Delivered;
+      ArqStats->Unacked         = (uint32_t)Stats.Unacked;
+      RetStatus = true;
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_GetArqStats() */
+
+
+/******************************************************************************
+** Function: RADIO_GetFragStats
+**
+** Report the fragmentation counters
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_GetFragStats(RADIO_FragStats_t *FragStats)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized() && Frag != NULL)
+   {
+      Fragmenter::Stats_t Stats = Frag->GetStats();
+      
+      FragStats->MessagesSent      = (uint32_t)Stats.MessagesSent;
+      FragStats->MessagesReceived  = (uint32_t)Stats.MessagesReceived;
+      FragStats->FragmentsSent     = (uint32_t)Stats.FragmentsSent;
+      FragStats->FragmentsReceived = (uint32_t)Stats.FragmentsReceived;
+      FragStats->SendTimeouts      = (uint32_t)Stats.SendTimeouts;
+      FragStats->Timeouts          = (uint32_t)Stats.Timeouts;
+      FragStats->Evictions         = (uint32_t)Stats.Evictions;
+      FragStats->Duplicates        = (uint32_t)Stats.Duplicates;
+      FragStats->BadFragments      = (uint32_t)Stats.BadFragments;
+      FragStats->SequenceGaps      = (uint32_t)Stats.SequenceGaps;
+      RetStatus = true;
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_GetFragStats() */
+
+
+/******************************************************************************
+** Function: RADIO_GetRxStats
+**
+** Report the RX packet ring counters
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_GetRxStats(RADIO_RxStats_t *RxStats)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized())
+   {
+      SX128x::RxRingStats_t Stats = Radio->GetRxRingStats();
+      
+      RxStats->Slots         = (uint32_t)Stats.Slots;
+      RxStats->Pending       = (uint32_t)Stats.Pending;
+      RxStats->HighWaterMark = (uint32_t)Stats.HighWaterMark;
+      RxStats->Received      = (uint32_t)Stats.Received;
+      RxStats->Overflows     = (uint32_t)Stats.Overflows;
+      RxStats->FecCorrected  = (uint32_t)Stats.FecCorrected;
+      RxStats->FecFailures   = (uint32_t)Stats.FecFailures;
+      RetStatus = true;
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_GetRxStats() */
+
+
+/******************************************************************************
+** Function: RADIO_GetRxSessionStats
+**
+** Report the counters of the current or last continuous receive session
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_GetRxSessionStats(RADIO_RxSessionStats_t *SessionStats)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized())
+   {
+      SX128x::RxSessionStats_t Stats = Radio->GetRxSessionStats();
+      
+      SessionStats->Active             = Stats.Active;
+      SessionStats->SessionTime        = Stats.SessionTime;
+      SessionStats->BlindTime          = Stats.BlindTime;
+      SessionStats->BlindWindows       = Stats.BlindWindows;
+      SessionStats->LongestBlindWindow = Stats.LongestBlindWindow;
+      SessionStats->Packets            = Stats.Packets;
+      SessionStats->BufferGaps         = Stats.BufferGaps;
+      SessionStats->BufferPointer      = Stats.BufferPointer;
+      RetStatus = true;
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_GetRxSessionStats() */
+
+
+/******************************************************************************
+** Function: RADIO_GetTxStats
+**
+** Report the TX queue counters
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_GetTxStats(RADIO_TxStats_t *TxStats)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized())
+   {
+      SX128x::TxQueueStats_t Stats = Radio->GetTxQueueStats();
+      
+      TxStats->Slots         = (uint32_t)Stats.Slots;
+      TxStats->Pending       = (uint32_t)Stats.Pending;
+      TxStats->HighWaterMark = (uint32_t)Stats.HighWaterMark;
+      TxStats->Sent          = (uint32_t)Stats.Sent;
+      TxStats->Timeouts      = (uint32_t)Stats.Timeouts;
+      TxStats->Overflows     = (uint32_t)Stats.Overflows;
+      TxStats->Preloaded     = (uint32_t)Stats.Preloaded;
+      RetStatus = true;
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_GetTxStats() */
+
+
+/******************************************************************************
+** Function: RADIO_MeasureCmdRate
+**
+** Measure how many radio commands per second the SPI link sustains
+**
+** Notes:
+**   1. See radio.h
+**
+*/
+uint32_t RADIO_MeasureCmdRate(uint32_t CmdCount)
+{
+   
+   uint32_t CmdRate = 0;
+   
+   if (SX128X_Initialized() && CmdCount > 0)
+   {
+      CmdRate = (uint32_t)Radio->MeasureCommandRate(CmdCount);
+   }
+   
+   return CmdRate;
+   
+} /* End RADIO_MeasureCmdRate() */
+
+
+/******************************************************************************
+** Function: RADIO_PollAggregation
+**
+** Send the frame being filled if its oldest message waited MaxDelayMs
+**
+** Notes:
+**   1. See radio.h
+**
+*/
+bool RADIO_PollAggregation(void)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized() && Agg != NULL)
+   {
+      try
+      {
+         RetStatus = Agg->Poll();
+      }
+      catch (...)
+      {
+         RetStatus = false;
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_PollAggregation() */
+
+
+/******************************************************************************
+** Function: RADIO_ReceiveAggregated
+**
+** Take the oldest received message, waiting up to TimeoutMs for one
+**
+** Notes:
+**   1. See radio.h
+**   2. The frame being split stays in AggRxPacket between calls
+**
+*/
+bool RADIO_ReceiveAggregated(RADIO_RxPacket_t *RxPacket, uint32_t TimeoutMs)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized() && Agg != NULL)
+   {
+      auto Deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TimeoutMs);
+      const uint8_t *Data = AggRxPacket.Payload;
+      uint8_t Length = AggRxPacket.Size;
+      
+      while (!RetStatus)
+      {
+         if (AggRxPending)
+         {
+            AggRxPending = Agg->Next(AggRxPacket.Payload, AggRxPacket.Size, AggRxOffset, Data, Length);
+            RetStatus = AggRxPending;
+         }
+         else
+         {
+            auto Remaining = std::chrono::duration_cast<std::chrono::milliseconds>(Deadline - std::chrono::steady_clock::now());
+            
+            if (!Radio->ReceivePacket(AggRxPacket, Remaining.count() > 0 ? (uint32_t)Remaining.count() : 0))
+            {
+               break;
+            }
+            
+            AggRxOffset  = 0;
+            AggRxPending = Agg->Input(AggRxPacket.Payload, AggRxPacket.Size);
+            
+            if (!AggRxPending)
+            {
+               Data      = AggRxPacket.Payload;
+               Length    = AggRxPacket.Size;
+               RetStatus = true;
+            }
+         }
+      }
+      
+      if (RetStatus)
+      {
+         RxPacket->Timestamp  = AggRxPacket.Timestamp;
+         RxPacket->PacketType = (uint8_t)AggRxPacket.PacketType;
+         RxPacket->Rssi       = AggRxPacket.Rssi;
+         RxPacket->Snr        = AggRxPacket.Snr;
+         RxPacket->FreqError  = AggRxPacket.FrequencyError;
+         RxPacket->Length     = Length;
+         memcpy(RxPacket->Data, Data, Length);
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_ReceiveAggregated() */
+
+
+/******************************************************************************
+** Function: RADIO_ReceiveMessage
+**
+** Take the oldest reassembled message, waiting up to TimeoutMs for one
+**
+** Notes:
+**   1. See radio.h
+**
+*/
+bool RADIO_ReceiveMessage(uint8_t *Stream, uint8_t *Msg, uint16_t *Length, uint16_t MaxLength,
+                          uint32_t TimeoutMs)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized() && Frag != NULL)
+   {
+      auto Deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TimeoutMs);
+      SX128x::RxPacket_t Packet;
+      
+      while (!(RetStatus = Frag->Receive(*Stream, Msg, *Length, MaxLength)))
+      {
+         auto Remaining = std::chrono::duration_cast<std::chrono::milliseconds>(Deadline - std::chrono::steady_clock::now());
+         
+         if (!Radio->ReceivePacket(Packet, Remaining.count() > 0 ? (uint32_t)Remaining.count() : 0))
+         {
+            break;
+         }
+         
+         Frag->Input(Packet.Payload, Packet.Size);
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_ReceiveMessage() */
+
+
+/******************************************************************************
+** Function: RADIO_ReceivePacket
+**
+** Take the oldest received packet without waiting
+**
+** Notes:
+**   1. See radio.h
+**
+*/
+bool RADIO_ReceivePacket(RADIO_RxPacket_t *RxPacket)
+{
+   
+   return RADIO_ReceivePacketTimed(RxPacket, 0);
+   
+} /* End RADIO_ReceivePacket() */
+
+
+/******************************************************************************
+** Function: RADIO_ReceivePacketTimed
+**
+** Take the oldest received packet, waiting up to TimeoutMs for one
+**
+** Notes:
+**   1. See radio.h
+**
+*/
+bool RADIO_ReceivePacketTimed(RADIO_RxPacket_t *RxPacket, uint32_t TimeoutMs)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized())
+   {
+      SX128x::RxPacket_t Packet;
+      
+      if (Radio->ReceivePacket(Packet, TimeoutMs))
+      {
+         RxPacket->Timestamp  = Packet.Timestamp;
+         RxPacket->PacketType = (uint8_t)Packet.PacketType;
+         RxPacket->Rssi       = Packet.Rssi;
+         RxPacket->Snr        = Packet.Snr;
+         RxPacket->FreqError  = Packet.FrequencyError;
+         RxPacket->Length     = Packet.Size;
+         memcpy(RxPacket->Data, Packet.Payload, Packet.Size);
+         RetStatus = true;
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_ReceivePacketTimed() */
+
+
 /******************************************************************************
-** Function: RADIO_Constructor
+** Function: RADIO_SendAggregated
 **
-** Initialize the Radio object to a known state
+** Add a small message to the frame being filled
 **
 ** Notes:
-**   1. This must be called prior to any other function.
+**   1. See radio.h
 **
 */
-bool RADIO_Constructor(const char *SpiDevStr, uint8_t SpiDevNum, const RADIO_Pin_t *RadioPin)
+bool RADIO_SendAggregated(const uint8_t *Data, uint8_t Length)
 {
+   
    bool RetStatus = false;
    
-   SX128x_Linux::PinConfig PinConfig;
+   if (SX128X_Initialized() && Agg != NULL)
+   {
+      try
+      {
+         RetStatus = Agg->Send(Data, Length);
+      }
+      catch (...)
+      {
+         RetStatus = false;
+      }
+   }
    
-   PinConfig.busy  = RadioPin->Busy;
-   PinConfig.nrst  = RadioPin->Nrst;
-   PinConfig.nss   = RadioPin->Nss;
-   PinConfig.dio1  = RadioPin->Dio1;
-   PinConfig.dio2  = RadioPin->Dio2;
-   PinConfig.dio3  = RadioPin->Dio3;
-   PinConfig.tx_en = RadioPin->TxEn;
-   PinConfig.rx_en = RadioPin->RxEn;
+   return RetStatus;
    
-   try
+} /* End RADIO_SendAggregated() */
+
+
+/******************************************************************************
+** Function: RADIO_SendMessage
+**
+** Send a message of any length up to the fragmentation MaxLength
+**
+** Notes:
+**   1. See radio.h
+**
+*/
+bool RADIO_SendMessage(uint8_t Stream, const uint8_t *Msg, uint16_t Length, uint32_t TimeoutMs)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized() && Frag != NULL)
    {
-      Radio = new SX128x_Linux(SpiDevStr, SpiDevNum, PinConfig);
+      try
+      {
+         RetStatus = Frag->Send(Stream, Msg, Length, TimeoutMs);
+      }
+      catch (...)
+      {
+         RetStatus = false;
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_SendMessage() */
+
+
+/******************************************************************************
+** Function: RADIO_SendPacket
+**
+** Queue a packet for transmission
+**
+** Notes:
+**   1. See radio.h
+**
+*/
+bool RADIO_SendPacket(const uint8_t *Data, uint8_t Length)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized())
+   {
+      try
+      {
+         RetStatus = Radio->QueuePacket(Data, Length);
+      }
+      catch (...)
+      {
+         RetStatus = false;
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_SendPacket() */
+
+
+/******************************************************************************
+** Function: RADIO_SetDeferredBusyCheck
+**
+** Enable or disable deferred radio BUSY checking
+**
+** Notes:
+**   1. Also called during library initialization, before SX128X_Initialized()
+**      reports true
+**
+*/
+bool RADIO_SetDeferredBusyCheck(bool Enable)
+{
+   
+   bool RetStatus = false;
+   
+   if (Radio != NULL)
+   {
+      Radio->SetDeferredBusyCheck(Enable);
       RetStatus = true;
    }
-   catch (...)
+   
+   return RetStatus;
+   
+} /* End RADIO_SetDeferredBusyCheck() */
+
+
+/******************************************************************************
+** Function: RADIO_SetFec
+**
+** Protect packets with Reed-Solomon parity bytes instead of the radio CRC
+**
+** Notes:
+**   1. Called during library initialization, before SX128X_Initialized()
+**      reports true
+**
+*/
+bool RADIO_SetFec(uint8_t Parity)
+{
+   
+   bool RetStatus = false;
+   
+   if (Radio != NULL)
    {
-      RetStatus = false;
+      try
+      {
+         Radio->SetFec(Parity);
+         RetStatus = true;
+      }
+      catch (...)
+      {
+         RetStatus = false;
+      }
    }
    
    return RetStatus;
    
-} /* End RADIO_Constructor() */
+} /* End RADIO_SetFec() */
 
 
 /******************************************************************************
@@ -113,6 +1033,68 @@ bool RADIO_SetLowNoiseAmpMode(uint16_t LowNoiseAmpMode)
 } /* RADIO_SetLowNoiseAmpMode() */
 
 
+/******************************************************************************
+** Function: RADIO_SetModulation
+**
+** Set the packet type and its modulation parameters
+**
+** Notes:
+**   1. See radio.h
+**
+*/
+bool RADIO_SetModulation(const RADIO_ModulationParams_t *ModulationParams)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized())
+   {
+      SX128x::ModulationParams_t Params = {};
+      
+      Params.PacketType = (SX128x::RadioPacketTypes_t)ModulationParams->PacketType;
+      
+      switch (ModulationParams->PacketType)
+      {
+         case RADIO_PACKET_TYPE_GFSK:
+            Params.Params.Gfsk.BitrateBandwidth  = (SX128x::RadioGfskBleBitrates_t)ModulationParams->Params.Gfsk.BitrateBandwidth;
+            Params.Params.Gfsk.ModulationIndex   = (SX128x::RadioGfskBleModIndexes_t)ModulationParams->Params.Gfsk.ModulationIndex;
+            Params.Params.Gfsk.ModulationShaping = (SX128x::RadioModShapings_t)ModulationParams->Params.Gfsk.ModulationShaping;
+            RetStatus = true;
+            break;
+         case RADIO_PACKET_TYPE_LORA:
+            Params.Params.LoRa.SpreadingFactor   = (SX128x::RadioLoRaSpreadingFactors_t)ModulationParams->Params.LoRa.SpreadingFactor;
+            Params.Params.LoRa.Bandwidth         = (SX128x::RadioLoRaBandwidths_t)ModulationParams->Params.LoRa.Bandwidth;
+            Params.Params.LoRa.CodingRate        = (SX128x::RadioLoRaCodingRates_t)ModulationParams->Params.LoRa.CodingRate;
+            RetStatus = true;
+            break;
+         case RADIO_PACKET_TYPE_FLRC:
+            Params.Params.Flrc.BitrateBandwidth  = (SX128x::RadioFlrcBitrates_t)ModulationParams->Params.Flrc.BitrateBandwidth;
+            Params.Params.Flrc.CodingRate        = (SX128x::RadioFlrcCodingRates_t)ModulationParams->Params.Flrc.CodingRate;
+            Params.Params.Flrc.ModulationShaping = (SX128x::RadioModShapings_t)ModulationParams->Params.Flrc.ModulationShaping;
+            RetStatus = true;
+            break;
+         default:
+            break;
+      }
+      
+      if (RetStatus)
+      {
+         try
+         {
+            Radio->SetModulationParams(Params);
+         }
+         catch (...)
+         {
+            RetStatus = false;
+         }
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_SetModulation() */
+
+
 /******************************************************************************
 ** Function: RADIO_SetModulationParams
 **
@@ -147,6 +1129,80 @@ bool RADIO_SetModulationParams(uint8_t SpreadingFactor,
 } /* RADIO_SetModulationParams() */
 
 
+/******************************************************************************
+** Function: RADIO_SetPacketParams
+**
+** Set the packet parameters of the current packet type
+**
+** Notes:
+**   1. See radio.h
+**   2. Checked against the local copy of the packet type, so a mismatch
+**      doesn't silently change the type set with the modulation
+**
+*/
+bool RADIO_SetPacketParams(const RADIO_PacketParams_t *PacketParams)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized() && PacketParams->PacketType == (uint8_t)Radio->GetPacketType(true))
+   {
+      SX128x::PacketParams_t Params = {};
+      
+      Params.PacketType = (SX128x::RadioPacketTypes_t)PacketParams->PacketType;
+      
+      switch (PacketParams->PacketType)
+      {
+         case RADIO_PACKET_TYPE_GFSK:
+            Params.Params.Gfsk.PreambleLength = (SX128x::RadioPreambleLengths_t)PacketParams->Params.Gfsk.PreambleLength;
+            Params.Params.Gfsk.SyncWordLength = (SX128x::RadioSyncWordLengths_t)PacketParams->Params.Gfsk.SyncWordLength;
+            Params.Params.Gfsk.SyncWordMatch  = (SX128x::RadioSyncWordRxMatchs_t)PacketParams->Params.Gfsk.SyncWordMatch;
+            Params.Params.Gfsk.HeaderType     = (SX128x::RadioPacketLengthModes_t)PacketParams->Params.Gfsk.HeaderType;
+            Params.Params.Gfsk.PayloadLength  = PacketParams->Params.Gfsk.PayloadLength;
+            Params.Params.Gfsk.CrcLength      = (SX128x::RadioCrcTypes_t)PacketParams->Params.Gfsk.CrcLength;
+            Params.Params.Gfsk.Whitening      = (SX128x::RadioWhiteningModes_t)PacketParams->Params.Gfsk.Whitening;
+            RetStatus = true;
+            break;
+         case RADIO_PACKET_TYPE_LORA:
+            Params.Params.LoRa.PreambleLength = PacketParams->Params.LoRa.PreambleLength;
+            Params.Params.LoRa.HeaderType     = (SX128x::RadioLoRaPacketLengthsModes_t)PacketParams->Params.LoRa.HeaderType;
+            Params.Params.LoRa.PayloadLength  = PacketParams->Params.LoRa.PayloadLength;
+            Params.Params.LoRa.Crc            = (SX128x::RadioLoRaCrcModes_t)PacketParams->Params.LoRa.Crc;
+            Params.Params.LoRa.InvertIQ       = (SX128x::RadioLoRaIQModes_t)PacketParams->Params.LoRa.InvertIQ;
+            RetStatus = true;
+            break;
+         case RADIO_PACKET_TYPE_FLRC:
+            Params.Params.Flrc.PreambleLength = (SX128x::RadioPreambleLengths_t)PacketParams->Params.Flrc.PreambleLength;
+            Params.Params.Flrc.SyncWordLength = (SX128x::RadioFlrcSyncWordLengths_t)PacketParams->Params.Flrc.SyncWordLength;
+            Params.Params.Flrc.SyncWordMatch  = (SX128x::RadioSyncWordRxMatchs_t)PacketParams->Params.Flrc.SyncWordMatch;
+            Params.Params.Flrc.HeaderType     = (SX128x::RadioPacketLengthModes_t)PacketParams->Params.Flrc.HeaderType;
+            Params.Params.Flrc.PayloadLength  = PacketParams->Params.Flrc.PayloadLength;
+            Params.Params.Flrc.CrcLength      = (SX128x::RadioCrcTypes_t)PacketParams->Params.Flrc.CrcLength;
+            Params.Params.Flrc.Whitening      = (SX128x::RadioWhiteningModes_t)PacketParams->Params.Flrc.Whitening;
+            RetStatus = true;
+            break;
+         default:
+            break;
+      }
+      
+      if (RetStatus)
+      {
+         try
+         {
+            Radio->SetPacketParams(Params);
+         }
+         catch (...)
+         {
+            RetStatus = false;
+         }
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_SetPacketParams() */
+
+
 /******************************************************************************
 ** Function: RADIO_SetPowerAmpRampTime
 **
@@ -239,6 +1295,62 @@ bool RADIO_SetSpiSpeed(uint32_t SpiSpeed)
 } /* End RADIO_SetSpiSpeed() */
 
 
+/******************************************************************************
+** Function: RADIO_SetSpiExclusive
+**
+** Take or release exclusive ownership of the SPI device
+**
+** Notes:
+**   1. Not intended to be a ground command and assumes the Radio has been
+**      initialized
+**
+*/
+bool RADIO_SetSpiExclusive(bool Exclusive)
+{
+   
+   bool RetStatus = false;
+   
+   try
+   {
+      Radio->SetSpiExclusive(Exclusive);
+      RetStatus = true;
+   }
+   catch (...)
+   {
+      RetStatus = false;
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_SetSpiExclusive() */
+
+
+/******************************************************************************
+** Function: RADIO_SetTxDoubleBuffer
+**
+** Split the radio data buffer in two halves for the TX queue
+**
+** Notes:
+**   1. Called during library initialization, before SX128X_Initialized()
+**      reports true
+**
+*/
+bool RADIO_SetTxDoubleBuffer(bool Enable)
+{
+   
+   bool RetStatus = false;
+   
+   if (Radio != NULL)
+   {
+      Radio->SetTxDoubleBuffer(Enable);
+      RetStatus = true;
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_SetTxDoubleBuffer() */
+
+
 /******************************************************************************
 ** Function: RADIO_SetStandbyMode
 **
@@ -261,3 +1373,114 @@ bool RADIO_SetStandbyMode(uint16_t StandbyMode)
    return RetStatus;
    
 } /* End RADIO_SetStandbyMode() */
+
+
+/******************************************************************************
+** Function: RADIO_StartContinuousRx
+**
+** Put the radio in continuous receive mode
+**
+** Notes:
+**   1. See radio.h
+**
+*/
+bool RADIO_StartContinuousRx(void)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized())
+   {
+      Radio->SetDioIrqParamsAuto();
+      Radio->StartContinuousRx();
+      RetStatus = true;
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_StartContinuousRx() */
+
+
+/******************************************************************************
+** Function: RADIO_StartReceive
+**
+** Enable the IRQs the library handles and put the radio in receive mode
+**
+** Notes:
+**   1. The timeout is counted in 1 ms radio ticks
+**
+*/
+bool RADIO_StartReceive(uint16_t TimeoutMs)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized())
+   {
+      SX128x::TickTime_t Timeout = { SX128x::RADIO_TICK_SIZE_1000_US, TimeoutMs };
+      
+      Radio->SetDioIrqParamsAuto();
+      Radio->SetRx(Timeout);
+      RetStatus = true;
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_StartReceive() */
+
+
+/******************************************************************************
+** Function: RADIO_StopContinuousRx
+**
+** End the continuous receive session and put the radio in standby
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_StopContinuousRx(void)
+{
+   
+   bool RetStatus = false;
+   
+   if (SX128X_Initialized())
+   {
+      Radio->StopContinuousRx();
+      RetStatus = true;
+   }
+   
+   return RetStatus;
+   
+} /* End RADIO_StopContinuousRx() */
+
+
+/******************************************************************************
+** Function: StartIrqHandler
+**
+** Start the radio IRQ thread once
+**
+** Notes:
+**   1. The packet queues rely on the IRQ thread to run the radio callbacks
+**
+*/
+static bool StartIrqHandler(void)
+{
+   
+   bool RetStatus = true;
+   
+   if (!IrqHandlerStarted)
+   {
+      try
+      {
+         Radio->StartIrqHandler();
+         IrqHandlerStarted = true;
+      }
+      catch (...)
+      {
+         RetStatus = false;
+      }
+   }
+   
+   return RetStatus;
+   
+} /* End StartIrqHandler() */
@@ -36,12 +36,25 @@
 /** Macro Definitions **/
 /***********************/
 
+#define RADIO_RX_PACKET_MAX_LEN  255
+#define RADIO_TX_PACKET_MAX_LEN  255
 
 /**********************/
 /** Type Definitions **/
 /**********************/
 
 
+/*
+** Chip select mode, see RADIO_SPI_CS_MODE in the JSON init file
+*/
+typedef enum
+{
+   RADIO_SPI_CS_GPIO = 0,   /* NSS toggled through the RADIO_PIN_NSS GPIO */
+   RADIO_SPI_CS_HW   = 1    /* NSS driven by the spidev controller        */
+   
+} RADIO_SpiCsMode_t;
+
+
 typedef struct
 {
    uint8_t Busy;
@@ -56,6 +69,207 @@ typedef struct
 } RADIO_Pin_t;
 
 
+/*
+** Packet types RADIO_SetModulation() and RADIO_SetPacketParams() accept,
+** must match SX128x.hpp RadioPacketTypes_t
+*/
+typedef enum
+{
+   RADIO_PACKET_TYPE_GFSK = 0,
+   RADIO_PACKET_TYPE_LORA = 1,
+   RADIO_PACKET_TYPE_FLRC = 3
+   
+} RADIO_PacketType_t;
+
+
+/*
+** Modulation parameters, see RADIO_SetModulation(). Values are the
+** SX128x.hpp enumerations named in the comments.
+*/
+typedef struct
+{
+   uint8_t PacketType;                  /* RADIO_PacketType_t                 */
+   union
+   {
+      struct
+      {
+         uint8_t SpreadingFactor;       /* RadioLoRaSpreadingFactors_t        */
+         uint8_t Bandwidth;             /* RadioLoRaBandwidths_t              */
+         uint8_t CodingRate;            /* RadioLoRaCodingRates_t             */
+      } LoRa;
+      struct
+      {
+         uint8_t BitrateBandwidth;      /* RadioFlrcBitrates_t                */
+         uint8_t CodingRate;            /* RadioFlrcCodingRates_t             */
+         uint8_t ModulationShaping;     /* RadioModShapings_t                 */
+      } Flrc;
+      struct
+      {
+         uint8_t BitrateBandwidth;      /* RadioGfskBleBitrates_t             */
+         uint8_t ModulationIndex;       /* RadioGfskBleModIndexes_t           */
+         uint8_t ModulationShaping;     /* RadioModShapings_t                 */
+      } Gfsk;
+   } Params;
+
+} RADIO_ModulationParams_t;
+
+
+/*
+** Packet parameters, see RADIO_SetPacketParams(). Values are the SX128x.hpp
+** enumerations named in the comments.
+*/
+typedef struct
+{
+   uint8_t PacketType;                  /* RADIO_PacketType_t                 */
+   union
+   {
+      struct
+      {
+         uint8_t PreambleLength;        /* Mantissa in bits 3:0, exponent in 7:4 */
+         uint8_t HeaderType;            /* RadioLoRaPacketLengthsModes_t      */
+         uint8_t PayloadLength;
+         uint8_t Crc;                   /* RadioLoRaCrcModes_t                */
+         uint8_t InvertIQ;              /* RadioLoRaIQModes_t                 */
+      } LoRa;
+      struct
+      {
+         uint8_t PreambleLength;        /* RadioPreambleLengths_t             */
+         uint8_t SyncWordLength;        /* RadioFlrcSyncWordLengths_t         */
+         uint8_t SyncWordMatch;         /* RadioSyncWordRxMatchs_t            */
+         uint8_t HeaderType;            /* RadioPacketLengthModes_t           */
+         uint8_t PayloadLength;
+         uint8_t CrcLength;             /* RadioCrcTypes_t                    */
+         uint8_t Whitening;             /* RadioWhiteningModes_t              */
+      } Flrc;
+      struct
+      {
+         uint8_t PreambleLength;        /* RadioPreambleLengths_t             */
+         uint8_t SyncWordLength;        /* RadioSyncWordLengths_t             */
+         uint8_t SyncWordMatch;         /* RadioSyncWordRxMatchs_t            */
+         uint8_t HeaderType;            /* RadioPacketLengthModes_t           */
+         uint8_t PayloadLength;
+         uint8_t CrcLength;             /* RadioCrcTypes_t                    */
+         uint8_t Whitening;             /* RadioWhiteningModes_t              */
+      } Gfsk;
+   } Params;
+
+} RADIO_PacketParams_t;
+
+
+/*
+** Packet received by the library, see RADIO_ReceivePacket()
+*/
+typedef struct
+{
+   uint64_t Timestamp;   /* Time of the RX done IRQ, nanoseconds (CLOCK_MONOTONIC) */
+   uint8_t  PacketType;  /* SX128x::RadioPacketTypes_t                        */
+   int8_t   Rssi;        /* dBm                                               */
+   int8_t   Snr;         /* dB, LoRa only                                     */
+   int32_t  FreqError;   /* Hz, LoRa only                                     */
+   uint8_t  Length;
+   uint8_t  Data[RADIO_RX_PACKET_MAX_LEN];
+
+} RADIO_RxPacket_t;
+
+
+typedef struct
+{
+   uint32_t Slots;
+   uint32_t Pending;
+   uint32_t HighWaterMark;
+   uint32_t Received;    /* Packets stored by the library           */
+   uint32_t Overflows;   /* Packets dropped because no slot was free */
+   uint32_t FecCorrected;   /* Bytes corrected by the FEC                  */
+   uint32_t FecFailures;    /* Packets dropped, too corrupted for the FEC  */
+
+} RADIO_RxStats_t;
+
+
+/*
+** Continuous receive session counters, times in nanoseconds
+*/
+typedef struct
+{
+   bool     Active;
+   uint64_t SessionTime;
+   uint64_t BlindTime;           /* Part of SessionTime the radio wasn't receiving */
+   uint64_t BlindWindows;        /* Times the radio left receive mode              */
+   uint64_t LongestBlindWindow;
+   uint64_t Packets;
+   uint64_t BufferGaps;          /* Packets that didn't follow the previous one in the radio buffer */
+   uint8_t  BufferPointer;
+
+} RADIO_RxSessionStats_t;
+
+
+typedef struct
+{
+   uint32_t Slots;
+   uint32_t Pending;     /* Includes the packet on air                   */
+   uint32_t HighWaterMark;
+   uint32_t Sent;
+   uint32_t Timeouts;
+   uint32_t Overflows;   /* Packets refused because no slot was free      */
+   uint32_t Preloaded;   /* Packets uploaded while the previous one was on air */
+
+} RADIO_TxStats_t;
+
+
+/*
+** Aggregation counters, see RADIO_SendAggregated() and RADIO_ReceiveAggregated()
+*/
+typedef struct
+{
+   uint32_t MessagesSent;
+   uint32_t FramesSent;
+   uint32_t SizeFlushes;        /* Frames sent because the next message didn't fit   */
+   uint32_t AgeFlushes;         /* Frames sent because a message waited MaxDelayMs   */
+   uint32_t Drops;              /* Messages lost because the TX queue was full       */
+   uint32_t FramesReceived;
+   uint32_t MessagesReceived;
+   uint32_t BadFrames;          /* Frames with a message size overrunning the frame  */
+
+} RADIO_AggStats_t;
+
+
+/*
+** ARQ counters, see RADIO_ArqSend() and RADIO_ArqReceive()
+*/
+typedef struct
+{
+   uint32_t FramesSent;         /* Data frames sent, retransmissions included        */
+   uint32_t Retransmissions;    /* Data frames sent again                            */
+   uint32_t AckTimeouts;        /* Polls left without an ack in time                 */
+   uint32_t AcksSent;
+   uint32_t AcksReceived;
+   uint32_t FramesReceived;
+   uint32_t Duplicates;         /* Data frames received twice                        */
+   uint32_t OutOfWindow;        /* Data frames beyond the receive window             */
+   uint32_t Delivered;          /* Payloads handed over by RADIO_ArqReceive()        */
+   uint32_t Unacked;            /* Frames waiting for an ack                         */
+
+} RADIO_ArqStats_t;
+
+
+/*
+** Fragmentation counters, see RADIO_SendMessage() and RADIO_ReceiveMessage()
+*/
+typedef struct
+{
+   uint32_t MessagesSent;
+   uint32_t MessagesReceived;
+   uint32_t FragmentsSent;
+   uint32_t FragmentsReceived;
+   uint32_t SendTimeouts;   /* Messages not sent within their timeout                */
+   uint32_t Timeouts;       /* Partial messages dropped, fragments stopped coming    */
+   uint32_t Evictions;      /* Partial messages dropped to free a reassembly slot    */
+   uint32_t Duplicates;     /* Fragments received twice                              */
+   uint32_t BadFragments;   /* Fragments with an inconsistent header                 */
+   uint32_t SequenceGaps;   /* Messages missing from the sequence of a stream        */
+
+} RADIO_FragStats_t;
+
+
 /************************/
 /** Exported Functions **/
 /************************/
@@ -68,9 +282,410 @@ typedef struct
 **
 ** Notes:
 **   1. This must be called prior to any other function.
+**   2. In RADIO_SPI_CS_HW mode RadioPin->Nss is not used
+**
+*/
+bool RADIO_Constructor(const char *SpiDevStr, uint8_t SpiDevNum, const RADIO_Pin_t *RadioPin,
+                       RADIO_SpiCsMode_t SpiCsMode);
+
+
+/******************************************************************************
+** Function: RADIO_ArmTurnaround
+**
+** Answer every received packet with a fixed response sent by the radio
+**
+** Notes:
+**   1. The radio sends the response DelayUs after the end of a reception,
+**      without waiting for the library, then receives again. Received
+**      packets are still delivered through RADIO_ReceivePacket().
+**   2. The response is at most 128 bytes and DelayUs must exceed 33 us. With
+**      GPIO driven TX/RX enables DelayUs must also cover the IRQ latency.
+**   3. Call it again to change the response
+**   4. With an explicit LoRa header, requests longer than 256 bytes less the
+**      response overwrite it and a corrupted response goes out. Keep the
+**      requests short, or use an implicit header.
+**
+*/
+bool RADIO_ArmTurnaround(const uint8_t *Response, uint8_t Length, uint16_t DelayUs);
+
+
+/******************************************************************************
+** Function: RADIO_ArqProcess
+**
+** Run the ARQ until a frame comes in, for up to TimeoutMs
+**
+** Notes:
+**   1. Sends the frames queued by RADIO_ArqSend() and the lost ones, reads
+**      the received packets and answers the polls of the peer. Call it in a
+**      loop on both ends for as long as a transfer runs.
+**   2. Returns true if an ARQ frame came in, so the caller can queue more
+**      payloads or take the received ones
+**   3. Packets that aren't ARQ frames are dropped, don't mix it with
+**      RADIO_ReceivePacket()
+**   4. Starts continuous RX if it isn't running, the radio returns to it
+**      after each transmission. Keep it running until the transfer ends.
+**   5. The data frames and the acks go out through the TX queue, which takes
+**      one sending task only. Call it from one task, and don't mix it with
+**      RADIO_SendPacket() or RADIO_SendAggregated().
+**
+*/
+bool RADIO_ArqProcess(uint32_t TimeoutMs);
+
+
+/******************************************************************************
+** Function: RADIO_ArqReceive
+**
+** Take the next received payload, in the order it was sent
+**
+** Notes:
+**   1. Data holds 251 bytes. Returns false if the next payload isn't in.
+**
+*/
+bool RADIO_ArqReceive(uint8_t *Data, uint8_t *Length);
+
+
+/******************************************************************************
+** Function: RADIO_ArqSend
+**
+** Queue a payload for reliable delivery
+**
+** Notes:
+**   1. Length is at most 251 bytes, less the FEC parity
+**   2. Returns false if the window is full, RADIO_ArqProcess() frees it as
+**      the acks come in
+**   3. Only queues the payload, RADIO_ArqProcess() sends it. See its notes
+**      on mixing with RADIO_SendPacket() and RADIO_SendAggregated().
+**
+*/
+bool RADIO_ArqSend(const uint8_t *Data, uint8_t Length);
+
+
+/******************************************************************************
+** Function: RADIO_DisarmTurnaround
+**
+** Stop answering received packets and put the radio in standby
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_DisarmTurnaround(void);
+
+
+/******************************************************************************
+** Function: RADIO_EnableAggregation
+**
+** Make RADIO_SendAggregated() and RADIO_ReceiveAggregated() usable
+**
+** Notes:
+**   1. Messages are packed into frames of up to MaxFrameLength bytes, each
+**      prefixed with its length on one byte, after a one byte frame type.
+**      A frame is sent when the next message doesn't fit or its oldest
+**      message has waited MaxDelayMs.
+**   2. Needs the TX queue and the RX packet ring
+**
+*/
+bool RADIO_EnableAggregation(uint8_t MaxFrameLength, uint32_t MaxDelayMs);
+
+
+/******************************************************************************
+** Function: RADIO_EnableArq
+**
+** Make RADIO_ArqSend(), RADIO_ArqReceive() and RADIO_ArqProcess() usable
+**
+** Notes:
+**   1. Selective repeat: up to Window frames are sent ahead of the acks, and
+**      an ack reports each missing frame so only those are sent again. Both
+**      ends need the same Window, at most 32.
+**   2. The ack timeout is the time on air of the frames sent and of the ack,
+**      plus MarginMs. Set the modulation and FEC before enabling it.
+**   3. Needs the TX queue and the RX packet ring
+**
+*/
+bool RADIO_EnableArq(uint8_t Window, uint32_t MarginMs);
+
+
+/******************************************************************************
+** Function: RADIO_EnableFragmentation
+**
+** Make RADIO_SendMessage() and RADIO_ReceiveMessage() usable
+**
+** Notes:
+**   1. Messages up to MaxLength bytes are split into fragments of up to 248
+**      bytes. Slots messages can be reassembled at the same time, a partial
+**      message is dropped TimeoutMs after its first fragment.
+**   2. The reassembly slots are allocated once here
+**   3. Needs the TX queue and the RX packet ring
+**
+*/
+bool RADIO_EnableFragmentation(uint16_t Slots, uint16_t MaxLength, uint32_t TimeoutMs);
+
+
+/******************************************************************************
+** Function: RADIO_EnableRxPacketRing
+**
+** Make the library store received packets in a pool of preallocated slots
+**
+** Notes:
+**   1. The slots are allocated once here, receiving a packet doesn't
+**      allocate. Packets arriving while every slot is full are dropped and
+**      counted in RADIO_RxStats_t.Overflows.
+**   2. Also starts the radio IRQ thread the first time it's called
+**
+*/
+bool RADIO_EnableRxPacketRing(uint16_t Slots);
+
+
+/******************************************************************************
+** Function: RADIO_EnableTxQueue
+**
+** Make the library queue packets passed to RADIO_SendPacket()
+**
+** Notes:
+**   1. The slots are allocated once here. When a transmission ends the
+**      library starts the next queued packet from the IRQ thread, without
+**      waiting for the app.
+**   2. Also starts the radio IRQ thread the first time it's called
+**
+*/
+bool RADIO_EnableTxQueue(uint16_t Slots);
+
+
+/******************************************************************************
+** Function: RADIO_GetAggStats
+**
+** Report the aggregation counters
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_GetAggStats(RADIO_AggStats_t *AggStats);
+
+
+/******************************************************************************
+** Function: RADIO_GetArqStats
+**
+** Report the ARQ counters
+**
+** Notes:
+**   None
 **
 */
-bool RADIO_Constructor(const char *SpiDevStr, uint8_t SpiDevNum, const RADIO_Pin_t *RadioPin);
+bool RADIO_GetArqStats(RADIO_ArqStats_t *ArqStats);
+
+
+/******************************************************************************
+** Function: RADIO_GetFragStats
+**
+** Report the fragmentation counters
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_GetFragStats(RADIO_FragStats_t *FragStats);
+
+
+/******************************************************************************
+** Function: RADIO_GetRxStats
+**
+** Report the RX packet ring counters
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_GetRxStats(RADIO_RxStats_t *RxStats);
+
+
+/******************************************************************************
+** Function: RADIO_GetRxSessionStats
+**
+** Report the counters of the current or last continuous receive session
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_GetRxSessionStats(RADIO_RxSessionStats_t *SessionStats);
+
+
+/******************************************************************************
+** Function: RADIO_GetTxStats
+**
+** Report the TX queue counters
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_GetTxStats(RADIO_TxStats_t *TxStats);
+
+
+/******************************************************************************
+** Function: RADIO_MeasureCmdRate
+**
+** Measure how many radio commands per second the SPI link sustains
+**
+** Notes:
+**   1. Sends CmdCount GetStatus commands and returns the achieved rate in
+**      commands per second, or 0 if the radio isn't initialized. Use it to
+**      compare the RADIO_SPI_CS_MODE settings on a given board.
+**   2. Blocks the caller for the duration of the measurement
+**
+*/
+uint32_t RADIO_MeasureCmdRate(uint32_t CmdCount);
+
+
+/******************************************************************************
+** Function: RADIO_PollAggregation
+**
+** Send the frame being filled if its oldest message waited MaxDelayMs
+**
+** Notes:
+**   1. Call it periodically, more often than MaxDelayMs, from the task
+**      calling RADIO_SendAggregated()
+**   2. Returns false if the TX queue refused the frame
+**
+*/
+bool RADIO_PollAggregation(void);
+
+
+/******************************************************************************
+** Function: RADIO_ReceiveAggregated
+**
+** Take the oldest received message, waiting up to TimeoutMs for one
+**
+** Notes:
+**   1. The messages of an aggregated frame are returned one by one, with
+**      the timestamp and signal of their frame. Other packets are returned
+**      whole.
+**   2. Don't mix it with RADIO_ReceivePacket()
+**   3. Only one task may receive messages
+**
+*/
+bool RADIO_ReceiveAggregated(RADIO_RxPacket_t *RxPacket, uint32_t TimeoutMs);
+
+
+/******************************************************************************
+** Function: RADIO_ReceiveMessage
+**
+** Take the oldest reassembled message, waiting up to TimeoutMs for one
+**
+** Notes:
+**   1. Returns false if no message was complete in time or it was larger
+**      than MaxLength. A message too large is dropped.
+**   2. Reads the received packets itself, packets that aren't fragments are
+**      dropped. Don't mix it with RADIO_ReceivePacket().
+**   3. Only one task may receive messages
+**
+*/
+bool RADIO_ReceiveMessage(uint8_t *Stream, uint8_t *Msg, uint16_t *Length, uint16_t MaxLength,
+                          uint32_t TimeoutMs);
+
+
+/******************************************************************************
+** Function: RADIO_ReceivePacket
+**
+** Take the oldest received packet without waiting
+**
+** Notes:
+**   1. Returns false if no packet is waiting
+**   2. Only one task may receive packets
+**
+*/
+bool RADIO_ReceivePacket(RADIO_RxPacket_t *RxPacket);
+
+
+/******************************************************************************
+** Function: RADIO_ReceivePacketTimed
+**
+** Take the oldest received packet, waiting up to TimeoutMs for one
+**
+** Notes:
+**   1. Returns false if no packet came in time
+**   2. Only one task may receive packets
+**
+*/
+bool RADIO_ReceivePacketTimed(RADIO_RxPacket_t *RxPacket, uint32_t TimeoutMs);
+
+
+/******************************************************************************
+** Function: RADIO_SendAggregated
+**
+** Add a small message to the frame being filled
+**
+** Notes:
+**   1. Length is at most MaxFrameLength - 2
+**   2. Returns false if the message is too long or a frame was refused by
+**      the TX queue
+**   3. Only one task may send packets, don't mix it with RADIO_SendPacket()
+**
+*/
+bool RADIO_SendAggregated(const uint8_t *Data, uint8_t Length);
+
+
+/******************************************************************************
+** Function: RADIO_SendMessage
+**
+** Send a message of any length up to the fragmentation MaxLength
+**
+** Notes:
+**   1. Blocks until the last fragment is sent, or TimeoutMs. Fragments are
+**      written from Msg straight into the radio, Msg isn't copied.
+**   2. Each Stream numbers its messages, so the receiver can tell them
+**      apart and count the missing ones
+**   3. Fragments are sent once the TX queue is empty
+**
+*/
+bool RADIO_SendMessage(uint8_t Stream, const uint8_t *Msg, uint16_t Length, uint32_t TimeoutMs);
+
+
+/******************************************************************************
+** Function: RADIO_SendPacket
+**
+** Queue a packet for transmission
+**
+** Notes:
+**   1. Returns false if the TX queue isn't enabled or is full, the packet is
+**      sent right away if the radio is idle
+**   2. Only one task may send packets
+**
+*/
+bool RADIO_SendPacket(const uint8_t *Data, uint8_t Length);
+
+
+/******************************************************************************
+** Function: RADIO_SetDeferredBusyCheck
+**
+** Enable or disable deferred radio BUSY checking
+**
+** Notes:
+**   1. When enabled commands return as soon as they are sent and the radio
+**      BUSY pin is only checked before the next command. See
+**      SX128x::SetDeferredBusyCheck.
+**
+*/
+bool RADIO_SetDeferredBusyCheck(bool Enable);
+
+
+/******************************************************************************
+** Function: RADIO_SetFec
+**
+** Protect packets with Reed-Solomon parity bytes instead of the radio CRC
+**
+** Notes:
+**   1. Parity bytes, at most 64, are appended to every packet sent and
+**      Parity / 2 corrupted bytes are corrected in every packet received.
+**      Packets too corrupted are dropped. 0 turns the FEC off.
+**   2. Both ends must use the same Parity. Each packet carries Parity bytes
+**      less payload.
+**   3. The radio CRC is off while the FEC is on
+**   4. Call it while the radio is idle
+**
+*/
+bool RADIO_SetFec(uint8_t Parity);
 
 
 /******************************************************************************
@@ -85,13 +700,27 @@ bool RADIO_Constructor(const char *SpiDevStr, uint8_t SpiDevNum, const RADIO_Pin
 bool RADIO_SetLowNoiseAmpMode(uint16_t LowNoiseAmpMode);
 
 
+/******************************************************************************
+** Function: RADIO_SetModulation
+**
+** Set the packet type and its modulation parameters
+**
+** Notes:
+**   1. Returns false for packet types other than GFSK, LoRa and FLRC
+**   2. Changing the packet type needs the radio in standby, stop the
+**      reception first. Set the packet parameters of the new type after.
+**
+*/
+bool RADIO_SetModulation(const RADIO_ModulationParams_t *ModulationParams);
+
+
 /******************************************************************************
 ** Function: RADIO_SetModulationParams
 **
 ** Set the radio Lora Modulation parameters
 **
 ** Notes:
-**   None
+**   1. See RADIO_SetModulation() for the other packet types
 **
 */
 bool RADIO_SetModulationParams(uint8_t SpreadingFactor,
@@ -99,6 +728,24 @@ bool RADIO_SetModulationParams(uint8_t SpreadingFactor,
                                uint8_t CodingRate);
 
 
+/******************************************************************************
+** Function: RADIO_SetPacketParams
+**
+** Set the packet parameters of the current packet type
+**
+** Notes:
+**   1. Returns false if PacketType isn't the one set by RADIO_SetModulation()
+**   2. Queued packets set PayloadLength themselves, in variable length mode
+**      it caps the received packets and is sent back before each reception
+**   3. FLRC payloads are at most 127 bytes, keep the fragment and frame
+**      sizes below it
+**   4. The CRC stays off while the FEC is on, and comes back with the
+**      requested setting when it's turned off
+**
+*/
+bool RADIO_SetPacketParams(const RADIO_PacketParams_t *PacketParams);
+
+
 /******************************************************************************
 ** Function: RADIO_SetRadioFrequency
 **
@@ -148,6 +795,36 @@ bool RADIO_SetPowerRegulatorMode(uint16_t PowerRegulatorMode);
 bool RADIO_SetSpiSpeed(uint32_t SpiSpeed);
 
 
+/******************************************************************************
+** Function: RADIO_SetSpiExclusive
+**
+** Take or release exclusive ownership of the SPI device
+**
+** Notes:
+**   1. Not intended to be a ground command and assumes the Radio has been
+**      initialized
+**   2. When exclusive the device is locked once and SPI transfers skip the
+**      per-transfer lock. Fails if another process holds the device.
+**
+*/
+bool RADIO_SetSpiExclusive(bool Exclusive);
+
+
+/******************************************************************************
+** Function: RADIO_SetTxDoubleBuffer
+**
+** Split the radio data buffer in two halves for the TX queue
+**
+** Notes:
+**   1. Packets of up to 128 bytes are then uploaded while the previous one is
+**      on air. Received packets may overwrite a preloaded one, so use it for
+**      bulk transmission.
+**   2. Call it while the TX queue is idle
+**
+*/
+bool RADIO_SetTxDoubleBuffer(bool Enable);
+
+
 /******************************************************************************
 ** Function: RADIO_SetStandbyMode
 **
@@ -160,4 +837,46 @@ bool RADIO_SetSpiSpeed(uint32_t SpiSpeed);
 bool RADIO_SetStandbyMode(uint16_t StandbyMode);
 
 
+/******************************************************************************
+** Function: RADIO_StartContinuousRx
+**
+** Put the radio in continuous receive mode
+**
+** Notes:
+**   1. The radio stays in receive mode after each packet, the packets are
+**      drained by the library into the RX packet ring. A transmission puts
+**      the radio back in receive mode as soon as it's done.
+**   2. Use RADIO_GetRxSessionStats() to see how long the radio wasn't
+**      receiving during the session
+**
+*/
+bool RADIO_StartContinuousRx(void);
+
+
+/******************************************************************************
+** Function: RADIO_StartReceive
+**
+** Enable the IRQs the library handles and put the radio in receive mode
+**
+** Notes:
+**   1. TimeoutMs of 0 receives one packet without timeout, 0xFFFF
+**      receives continuously. See RADIO_StartContinuousRx() for a receive
+**      mode that survives transmissions.
+**
+*/
+bool RADIO_StartReceive(uint16_t TimeoutMs);
+
+
+/******************************************************************************
+** Function: RADIO_StopContinuousRx
+**
+** End the continuous receive session and put the radio in standby
+**
+** Notes:
+**   None
+**
+*/
+bool RADIO_StopContinuousRx(void);
+
+
 #endif /* _radio_ */
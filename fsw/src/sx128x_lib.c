@@ -140,11 +140,55 @@ static bool InitRadio(void)
    
    RetStatus = RADIO_Constructor(INITBL_GetStrConfig(INITBL_OBJ, CFG_RADIO_SPI_DEV_STR),
                                  INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_SPI_DEV_NUM),
-                                 &RadioPin);
+                                 &RadioPin,
+                                 (RADIO_SpiCsMode_t)INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_SPI_CS_MODE));
    
    if (RetStatus)
    {
       RADIO_SetSpiSpeed(INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_SPI_SPEED));
+      
+      RADIO_SetDeferredBusyCheck(INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_DEFERRED_BUSY));
+      
+      if (INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_SPI_EXCLUSIVE))
+      {
+         RetStatus = RADIO_SetSpiExclusive(true);
+      }
+      
+      if (RetStatus && INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_RX_PACKET_SLOTS) > 0)
+      {
+         RetStatus = RADIO_EnableRxPacketRing(INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_RX_PACKET_SLOTS));
+      }
+      
+      if (RetStatus && INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_TX_QUEUE_SLOTS) > 0)
+      {
+         RetStatus = RADIO_EnableTxQueue(INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_TX_QUEUE_SLOTS));
+      }
+      
+      RADIO_SetTxDoubleBuffer(INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_TX_DOUBLE_BUFFER));
+      
+      if (RetStatus)
+      {
+         RetStatus = RADIO_SetFec(INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_FEC_PARITY));
+      }
+      
+      if (RetStatus && INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_FRAG_SLOTS) > 0)
+      {
+         RetStatus = RADIO_EnableFragmentation(INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_FRAG_SLOTS),
+                                               INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_FRAG_MAX_LEN),
+                                               INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_FRAG_TIMEOUT_MS));
+      }
+      
+      if (RetStatus && INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_AGG_MAX_FRAME_LEN) > 0)
+      {
+         RetStatus = RADIO_EnableAggregation(INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_AGG_MAX_FRAME_LEN),
+                                             INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_AGG_MAX_DELAY_MS));
+      }
+      
+      if (RetStatus && INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_ARQ_WINDOW) > 0)
+      {
+         RetStatus = RADIO_EnableArq(INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_ARQ_WINDOW),
+                                     INITBL_GetIntConfig(INITBL_OBJ, CFG_RADIO_ARQ_MARGIN_MS));
+      }
    }
    
    return RetStatus;
@@ -0,0 +1,234 @@
+/*
+    This file is part of SX128x Linux driver.
+    Copyright (C) 2020 ReimuNotMoe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Two ARQ ends joined by a simulated link, no radio needed. Each direction
+ * has a bounded TX queue sending one frame per airtime, then loses frames
+ * at random and delays them by a random jitter, which reorders them. Every
+ * scenario checks that the payloads come out whole and in order. Not part
+ * of the app build:
+ *
+ *   g++ -O2 -std=c++17 -pthread -Ifsw/src fsw/tools/arq_sim.cpp fsw/src/Arq.cpp \
+ *       fsw/src/SX128x.cpp fsw/src/ReedSolomon.cpp -o arq_sim
+ *   ./arq_sim
+ *
+ * The ARQ runs on the steady clock, so the scenarios take a few seconds.
+ */
+
+#include <chrono>
+#include <thread>
+#include <random>
+#include <deque>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+
+#include "Arq.hpp"
+
+namespace {
+	constexpr uint32_t AIR_TIME_MS = 1;
+	constexpr uint32_t MARGIN_MS = 5;
+	constexpr uint8_t WINDOW = 16;
+
+	typedef struct {
+		const char *Name;
+		uint32_t Payloads;
+		double DataLoss;                        //!< Data frames lost
+		double AckLoss;                         //!< Acks lost
+		uint32_t JitterMs;                      //!< Random delay added to each frame, reorders them
+		uint32_t AckBlackoutMs;                 //!< Every ack lost for this long after the start
+		size_t QueueSlots;                      //!< TX queue of each direction
+	} Scenario_t;
+
+	typedef struct {
+		uint64_t Time;                          //!< Leaves the TX queue, then arrives
+		std::vector<uint8_t> Frame;
+	} Frame_t;
+
+	/*!
+	 * \brief One direction of the link
+	 */
+	class Channel {
+		std::deque<Frame_t> Queue;
+		std::vector<Frame_t> Air;
+		uint64_t LastSent = 0;
+		size_t Slots;
+
+	public:
+		explicit Channel(size_t slots) : Slots(slots) {
+		}
+
+		bool Output(const uint8_t *frame, uint8_t size) {
+			// The radio TX queue is full
+			if (Queue.size() >= Slots) {
+				return false;
+			}
+
+			LastSent = std::max(LastSent, SX128x::SteadyClockNs()) + (uint64_t)AIR_TIME_MS * 1000000;
+			Queue.push_back({LastSent, std::vector<uint8_t>(frame, frame + size)});
+
+			return true;
+		}
+
+		/*!
+		 * \brief Moves the frames sent by now on air, losing and delaying
+		 *        them, and hands over those arrived
+		 */
+		template <typename Lost_t>
+		std::vector<std::vector<uint8_t>> Run(std::mt19937& random, uint32_t jitterMs, Lost_t lost) {
+			uint64_t now = SX128x::SteadyClockNs();
+			std::vector<std::vector<uint8_t>> arrived;
+
+			while (!Queue.empty() && Queue.front().Time <= now) {
+				Frame_t frame = std::move(Queue.front());
+				Queue.pop_front();
+
+				if (!lost(frame.Frame)) {
+					frame.Time += (uint64_t)( jitterMs ? random() % ( jitterMs + 1 ) : 0 ) * 1000000;
+					Air.push_back(std::move(frame));
+				}
+			}
+
+			for (auto it = Air.begin(); it != Air.end();) {
+				if (it->Time <= now) {
+					arrived.push_back(std::move(it->Frame));
+					it = Air.erase(it);
+				} else {
+					++it;
+				}
+			}
+
+			return arrived;
+		}
+	};
+
+	void FillPayload(uint32_t index, uint8_t *payload, uint8_t& size) {
+		size = 1 + ( index * 37 ) % Arq::PAYLOAD_MAX_SIZE;
+
+		for (uint8_t i = 0; i < size; i++) {
+			payload[i] = index * 7 + i;
+		}
+	}
+
+	bool RunScenario(const Scenario_t& scenario) {
+		std::mt19937 random(1);
+		std::uniform_real_distribution<double> uniform(0, 1);
+		Channel ab(scenario.QueueSlots), ba(scenario.QueueSlots);
+
+		Arq a([&](const uint8_t *frame, uint8_t size) { return ab.Output(frame, size); },
+		      [](uint8_t) { return AIR_TIME_MS; }, WINDOW, MARGIN_MS);
+		Arq b([&](const uint8_t *frame, uint8_t size) { return ba.Output(frame, size); },
+		      [](uint8_t) { return AIR_TIME_MS; }, WINDOW, MARGIN_MS);
+
+		uint64_t start = SX128x::SteadyClockNs();
+		uint64_t blackoutEnd = start + (uint64_t)scenario.AckBlackoutMs * 1000000;
+		uint64_t deadline = start + 60000000000ULL;
+		uint32_t queued = 0, received = 0, spins = 0;
+		bool ordered = true;
+
+		auto lost = [&](const std::vector<uint8_t>& frame) {
+			if (frame[0] == Arq::FRAME_TYPE_ACK) {
+				return SX128x::SteadyClockNs() < blackoutEnd || uniform(random) < scenario.AckLoss;
+			}
+
+			return uniform(random) < scenario.DataLoss;
+		};
+
+		while (received < scenario.Payloads && SX128x::SteadyClockNs() < deadline) {
+			uint8_t payload[Arq::PAYLOAD_MAX_SIZE], size;
+
+			for (; queued < scenario.Payloads; queued++) {
+				FillPayload(queued, payload, size);
+				if (!a.Send(payload, size)) {
+					break;
+				}
+			}
+
+			a.Poll();
+			b.Poll();
+
+			for (auto& frame : ab.Run(random, scenario.JitterMs, lost)) {
+				b.Input(frame.data(), frame.size());
+			}
+
+			for (auto& frame : ba.Run(random, scenario.JitterMs, lost)) {
+				a.Input(frame.data(), frame.size());
+			}
+
+			uint8_t expected[Arq::PAYLOAD_MAX_SIZE], expectedSize;
+
+			while (b.Receive(payload, size)) {
+				FillPayload(received, expected, expectedSize);
+				ordered = ordered && size == expectedSize && memcmp(payload, expected, size) == 0;
+				received++;
+			}
+
+			// A full TX queue must not make the caller spin
+			uint32_t interval = a.PollIntervalMs();
+
+			if (interval == 0) {
+				spins++;
+			}
+
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+
+		Arq::Stats_t sa = a.GetStats(), sb = b.GetStats();
+		bool lossy = scenario.DataLoss > 0 || scenario.AckLoss > 0 || scenario.AckBlackoutMs > 0;
+		bool pass = ordered && received == scenario.Payloads;
+
+		// Without losses nothing is sent twice, with them something is
+		pass = pass && ( lossy ? sa.Retransmissions > 0 : sa.Retransmissions == 0 );
+
+		// A zero interval is right while new frames wait, not for every pass
+		// of the loop while the TX queue is full
+		pass = pass && spins < scenario.Payloads;
+
+		// Acks lost for longer than the ack timeout are recovered by it
+		if (scenario.AckBlackoutMs > 0) {
+			pass = pass && sa.AckTimeouts > 0;
+		}
+
+		printf("%-22s %s  delivered %" PRIu32 "/%" PRIu32 " in order %s  sent %" PRIu64 " retx %" PRIu64
+		       " timeouts %" PRIu64 " acks %" PRIu64 " dup %" PRIu64 " busy polls %" PRIu32 " %.1f s\n",
+		       scenario.Name, pass ? "PASS" : "FAIL", received, scenario.Payloads, ordered ? "yes" : "no",
+		       sa.FramesSent, sa.Retransmissions, sa.AckTimeouts, sa.AcksReceived, sb.Duplicates, spins,
+		       ( SX128x::SteadyClockNs() - start ) / 1e9);
+
+		return pass;
+	}
+}
+
+int main() {
+	const Scenario_t scenarios[] = {
+		{"clean",                 500, 0,    0,    0, 0,   32},
+		{"data loss 10%",         500, 0.1,  0,    0, 0,   32},
+		{"data and ack loss 20%", 500, 0.2,  0.2,  0, 0,   32},
+		{"reordering",            500, 0.05, 0.05, 3, 0,   32},
+		{"ack blackout",          300, 0,    0,    0, 200, 32},
+		{"small TX queue",        500, 0.1,  0.1,  0, 0,   2},
+	};
+	bool pass = true;
+
+	for (const auto& it : scenarios) {
+		pass = RunScenario(it) && pass;
+	}
+
+	return pass ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+/*
+    This file is part of SX128x Linux driver.
+    Copyright (C) 2020 ReimuNotMoe
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Reed-Solomon throughput on the host CPU, in MB/s of data bytes, for full
+ * 255 bytes blocks. Not part of the app build:
+ *
+ *   g++ -O2 -std=c++17 -Ifsw/src fsw/tools/rs_bench.cpp fsw/src/ReedSolomon.cpp -o rs_bench
+ *   ./rs_bench [blocks]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+
+#include "ReedSolomon.hpp"
+
+namespace {
+	double MBps(size_t bytes, std::chrono::steady_clock::time_point start) {
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		return bytes / elapsed.count() / 1e6;
+	}
+}
+
+int main(int argc, char **argv) {
+	size_t blocks = argc > 1 ? strtoul(argv[1], nullptr, 0) : 20000;
+	uint8_t block[ReedSolomon::BLOCK_MAX_SIZE], work[ReedSolomon::BLOCK_MAX_SIZE];
+	unsigned int sink = 0;
+
+	srand(1);
+
+	printf("parity  data  encode MB/s  decode clean MB/s  decode t errors MB/s\n");
+
+	for (uint8_t parity : {4, 8, 16, 32}) {
+		ReedSolomon rs(parity);
+		size_t size = ReedSolomon::BLOCK_MAX_SIZE - parity;
+
+		for (size_t i = 0; i < size; i++) {
+			block[i] = rand();
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (size_t n = 0; n < blocks; n++) {
+			block[0] = n;
+			memset(block + size, 0, parity);
+			rs.Encode(block, size, block + size);
+			sink += block[size];
+		}
+
+		double encode = MBps(blocks * size, start);
+
+		// Syndromes only
+		start = std::chrono::steady_clock::now();
+
+		for (size_t n = 0; n < blocks; n++) {
+			memcpy(work, block, sizeof(block));
+			sink += rs.Decode(work, sizeof(block));
+		}
+
+		double clean = MBps(blocks * size, start);
+
+		// As many errors as the code corrects, the slowest case
+		start = std::chrono::steady_clock::now();
+
+		for (size_t n = 0; n < blocks; n++) {
+			memcpy(work, block, sizeof(block));
+			for (uint8_t e = 0; e < parity / 2; e++) {
+				work[( n + e * 37 ) % sizeof(block)] ^= 1 + e;
+			}
+			sink += rs.Decode(work, sizeof(block));
+		}
+
+		double corrected = MBps(blocks * size, start);
+
+		printf("%6u  %4zu  %11.1f  %17.1f  %15.1f\n", parity, size, encode, clean, corrected);
+	}
+
+	// Keeps the work from being optimized away
+	return sink == 0xFFFFFFFF;
+}